@@ -1,276 +1,143 @@
 #include <stdlib.h>
 #include <math.h>
 
+#include "../dsp/FFT.hpp"
+#include "../dsp/window_function.hpp"
+#include "../dsp/arena.hpp"
+
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
-#include <wasm_simd128.h>
 #endif
 
-typedef enum {
-  RECTANGULAR,
-  HANNING,
-  HAMMING
-} WINDOW_FUNCTION;
-
-
-static float *reals = nullptr;
-static float *imags = nullptr;
+typedef dsp::WINDOW_FUNCTION WINDOW_FUNCTION;
+typedef dsp::FFT_PLAN FFT_PLAN;
+typedef dsp::BATCH_LAYOUT BATCH_LAYOUT;
+
+// Buffers of one transform (e.g., a track). Plan is not owned, so that contexts of the same size share one plan,
+// and one module instance serves any number of contexts.
+// `reals` and `imags` have `number_of_channels` x N elements (single channel transform uses the first N elements).
+typedef struct {
+  dsp::ARENA *arena;
+  const FFT_PLAN *plan;
+  size_t number_of_channels;
+  float *reals;
+  float *imags;
+} FFT_CONTEXT;
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// 2^{n}
-static inline int pow2(const int n) {
-  if (n == 0) {
-    return 1;
-  }
-
-  return 2 << (n - 1);
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+void window_function(float *const window, const size_t size, const WINDOW_FUNCTION function) {
+  dsp::window_function(window, size, function);
 }
 
-static inline void swap(float *const reals, float *const imags, const int i, const size_t k) {
-  float tmp_real;
-  float tmp_imag;
-
-  tmp_real = reals[i];
-  tmp_imag = imags[i];
-
-  reals[i] = reals[k];
-  imags[i] = imags[k];
-
-  reals[k] = tmp_real;
-  imags[k] = tmp_imag;
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+FFT_PLAN *create_fft_plan(const size_t size) {
+  return dsp::create_fft_plan(size);
 }
 
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-void window_function(float *const window, const size_t size, const WINDOW_FUNCTION function) {
-  switch (function) {
-    case HANNING: {
-      for (int n = 0; n < size; n++) {
-        if (n & 0x00000001) {
-          window[n] = 0.5 - (0.5 * cosf(((2 * M_PI) * (n + 0.5)) / size));
-        } else {
-          window[n] = 0.5 - (0.5 * cosf(((2 * M_PI) * n) / size));
-        }
-      }
-
-      break;
-    }
-
-    case HAMMING: {
-      for (int n = 0; n < size; n++) {
-        if (n & 0x00000001) {
-          window[n] = 0.54 - (0.46 * cosf(((2 * M_PI) * (n + 0.5)) / size));
-        } else {
-          window[n] = 0.54 - (0.46 * cosf(((2 * M_PI) * n) / size));
-        }
-      }
-
-      break;
-    }
-
-    case RECTANGULAR: {
-      for (int n = 0; n < size; n++) {
-        window[n] = 1.0f;
-      }
-
-      break;
-    }
-  }
+void destroy_fft_plan(FFT_PLAN *fft_plan) {
+  dsp::destroy_fft_plan(fft_plan);
 }
 
+// Power of two size at or above this is computed by cache-blocked passes and bit-reversal
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-void FFT(const size_t size) {
-  int number_of_stages = (int)log2f((float)size);
-
-#ifdef __WASM_SIMD128_H
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      int rest = number_of_stages - stage;
-
-      for (int j = 0; j < pow2(rest); j++) {
-        int n = i * pow2(rest + 1) + j;
-        int m = pow2(rest) + n;
-
-        float w = 2.0f * M_PI * j * pow2(stage - 1);
-
-        float e_real = reals[n];
-        float e_imag = imags[n];
-        float o_real = reals[m];
-        float o_imag = imags[m];
-        float w_real = cosf(w / size);
-        float w_imag = 0.0f - sinf(w / size);
-
-        v128_t v1 = wasm_f32x4_make(e_real, e_imag,  (w_real * (e_real - o_real)), (w_real * (e_imag - o_imag)));
-        v128_t v2 = wasm_f32x4_make(o_real, o_imag, -(w_imag * (e_imag - o_imag)), (w_imag * (e_real - o_real)));
-
-        if (stage < number_of_stages) {
-          v128_t v = wasm_f32x4_add(v1, v2);
-
-          reals[n] = wasm_f32x4_extract_lane(v, 0);
-          imags[n] = wasm_f32x4_extract_lane(v, 1);
-          reals[m] = wasm_f32x4_extract_lane(v, 2);
-          imags[m] = wasm_f32x4_extract_lane(v, 3);
-        } else {
-          v128_t v_add = wasm_f32x4_add(v1, v2);
-          v128_t v_sub = wasm_f32x4_sub(v1, v2);
-
-          reals[n] = wasm_f32x4_extract_lane(v_add, 0);
-          imags[n] = wasm_f32x4_extract_lane(v_add, 1);
-          reals[m] = wasm_f32x4_extract_lane(v_sub, 0);
-          imags[m] = wasm_f32x4_extract_lane(v_sub, 1);
-        }
-      }
-    }
-  }
-#else
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      int rest = number_of_stages - stage;
-
-      for (int j = 0; j < pow2(rest); j++) {
-        int n = i * pow2(rest + 1) + j;
-        int m = pow2(rest) + n;
-
-        float w = 2.0f * M_PI * j * pow2(stage - 1);
-
-        float e_real = reals[n];
-        float e_imag = imags[n];
-        float o_real = reals[m];
-        float o_imag = imags[m];
-        float w_real = cosf(w / size);
-        float w_imag = 0.0f - sinf(w / size);
+size_t blocked_fft_min_size(void) {
+  return dsp::BLOCKED_FFT_MIN_SIZE;
+}
 
-        if (stage < number_of_stages) {
-          reals[n] = e_real + o_real;
-          imags[n] = e_imag + o_imag;
-          reals[m] = (w_real * (e_real - o_real)) - (w_imag * (e_imag - o_imag));
-          imags[m] = (w_real * (e_imag - o_imag)) + (w_imag * (e_real - o_real));
-        } else {
-          reals[n] = e_real + o_real;
-          imags[n] = e_imag + o_imag;
-          reals[m] = e_real - o_real;
-          imags[m] = e_imag - o_imag;
-        }
-      }
-    }
-  }
+// `fft_plan` must outlive the context. Returns `nullptr` if memory cannot be allocated.
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
 #endif
+FFT_CONTEXT *create_fft_context(const FFT_PLAN *fft_plan, const size_t number_of_channels) {
+  if (fft_plan == nullptr) {
+    return nullptr;
+  }
 
-  size_t *index = (size_t *)calloc(size, sizeof(size_t));
+  const size_t number_of_elements = number_of_channels * fft_plan->size;
 
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    int rest = number_of_stages - stage;
+  dsp::ARENA *arena = dsp::create_arena(dsp::arena_size(1, sizeof(FFT_CONTEXT)) + (2 * dsp::arena_size(number_of_elements, sizeof(float))));
 
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      index[(size_t)(pow2(stage - 1) + i)] = index[i] + (size_t)pow2(rest);
-    }
+  if (arena == nullptr) {
+    return nullptr;
   }
 
-  for (size_t k = 0; k < size; k++) {
-    if (index[k] <= k) {
-      continue;
-    }
+  FFT_CONTEXT *context = (FFT_CONTEXT *)dsp::arena_alloc(arena, 1, sizeof(FFT_CONTEXT));
 
-    swap(reals, imags, index[k], k);
-  }
+  context->arena              = arena;
+  context->plan               = fft_plan;
+  context->number_of_channels = number_of_channels;
+  context->reals              = dsp::arena_alloc_floats(arena, number_of_elements);
+  context->imags              = dsp::arena_alloc_floats(arena, number_of_elements);
 
-  free(index);
+  return context;
 }
 
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-void IFFT(const size_t size) {
-  int number_of_stages = (int)log2f((float)size);
-
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      int rest = number_of_stages - stage;
-
-      for (int j = 0; j < pow2(rest); j++) {
-        int n = i * pow2(rest + 1) + j;
-        int m = pow2(rest) + n;
-
-        float w = 2.0f * M_PI * j * pow2(stage - 1);
-
-        float e_real = reals[n];
-        float e_imag = imags[n];
-        float o_real = reals[m];
-        float o_imag = imags[m];
-        float w_real = cosf(w / size);
-        float w_imag = sinf(w / size);
-
-        if (stage < number_of_stages) {
-          reals[n] = e_real + o_real;
-          imags[n] = e_imag + o_imag;
-          reals[m] = (w_real * (e_real - o_real)) - (w_imag * (e_imag - o_imag));
-          imags[m] = (w_real * (e_imag - o_imag)) + (w_imag * (e_real - o_real));
-        } else {
-          reals[n] = e_real + o_real;
-          imags[n] = e_imag + o_imag;
-          reals[m] = e_real - o_real;
-          imags[m] = e_imag - o_imag;
-        }
-      }
-    }
-  }
-
-  size_t *index = (size_t *)calloc(size, sizeof(size_t));
-
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    int rest = number_of_stages - stage;
-
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      index[(size_t)(pow2(stage - 1) + i)] = index[i] + (size_t)pow2(rest);
-    }
-  }
-
-  for (int k = 0; k < size; k++) {
-    if (index[k] <= k) {
-      continue;
-    }
-
-    swap(reals, imags, index[k], k);
-  }
-
-  for (size_t k = 0; k < size; k++) {
-    reals[k] /= size;
-    imags[k] /= size;
+void destroy_fft_context(FFT_CONTEXT *context) {
+  if (context == nullptr) {
+    return;
   }
 
-  free(index);
+  // Context itself is in the arena
+  dsp::destroy_arena(context->arena);
 }
 
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *alloc_memory_reals(const size_t buffer_size) {
-  if (reals) {
-    free(reals);
-  }
+float *fft_context_reals(const FFT_CONTEXT *context) {
+  return context->reals;
+}
 
-  reals = (float *)calloc(buffer_size, sizeof(float));
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *fft_context_imags(const FFT_CONTEXT *context) {
+  return context->imags;
+}
 
-  return reals;
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+void execute_fft(FFT_CONTEXT *context) {
+  dsp::FFT(context->plan, context->reals, context->imags);
 }
 
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *alloc_memory_imags(const size_t buffer_size) {
-  if (imags) {
-    free(imags);
-  }
+void execute_ifft(FFT_CONTEXT *context) {
+  dsp::IFFT(context->plan, context->reals, context->imags);
+}
 
-  imags = (float *)calloc(buffer_size, sizeof(float));
+// Transforms every channel of context (`layout` is 0 (planar) or 1 (interleaved))
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+void execute_batch_fft(FFT_CONTEXT *context, const BATCH_LAYOUT layout) {
+  dsp::BATCH_FFT(context->plan, context->reals, context->imags, context->number_of_channels, layout);
+}
 
-  return imags;
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+void execute_batch_ifft(FFT_CONTEXT *context, const BATCH_LAYOUT layout) {
+  dsp::BATCH_IFFT(context->plan, context->reals, context->imags, context->number_of_channels, layout);
 }
 
 #ifdef __cplusplus
@@ -1,8 +1,9 @@
 #include <stdlib.h>
 
+#include "../dsp/SIMD.hpp"
+
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
-#include <wasm_simd128.h>
 #endif
 
 static float *inputs = nullptr;
@@ -17,22 +18,29 @@ EMSCRIPTEN_KEEPALIVE
 float SIMD(const size_t size) {
   float result = 0.0f;
 
-#ifdef __WASM_SIMD128_H
-  v128_t v = wasm_f32x4_make(0.0f, 0.0f, 0.0f, 0.0f);
+#ifdef DSP_SIMD
+  // 4 lanes on every backend (wasm, SSE2, AVX), so that the order of additions (and result) is the same
+  using dsp::F32X4;
+
+  F32X4::type v = F32X4::splat(0.0f);
 
   for (int i = 0; i < size; i += 8) {
-    v128_t v1 = wasm_f32x4_make(inputs[i + 0], inputs[i + 1], inputs[i + 2], inputs[i + 3]);
-    v128_t v2 = wasm_f32x4_make(inputs[i + 4], inputs[i + 5], inputs[i + 6], inputs[i + 7]);
+    F32X4::type v1 = F32X4::load(&inputs[i + 0]);
+    F32X4::type v2 = F32X4::load(&inputs[i + 4]);
 
-    v128_t v3 = wasm_f32x4_add(v1, v2);
+    F32X4::type v3 = F32X4::add(v1, v2);
 
-    v = wasm_f32x4_add(v, v3);
+    v = F32X4::add(v, v3);
   }
 
-  result += wasm_f32x4_extract_lane(v, 0);
-  result += wasm_f32x4_extract_lane(v, 1);
-  result += wasm_f32x4_extract_lane(v, 2);
-  result += wasm_f32x4_extract_lane(v, 3);
+  float lanes[4];
+
+  F32X4::store(lanes, v);
+
+  result += lanes[0];
+  result += lanes[1];
+  result += lanes[2];
+  result += lanes[3];
 #else
   for (int i = 0; i < size; i++) {
     result += inputs[i];
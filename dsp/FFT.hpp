@@ -0,0 +1,1397 @@
+#ifndef DSP_FFT_HPP
+#define DSP_FFT_HPP
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "SIMD.hpp"
+
+namespace dsp {
+
+// Maximum number of radix-4, 2, 3, 5 factors (enough for 32 bits size)
+static const int MAX_NUMBER_OF_FACTORS = 32;
+
+// Crossover size of cache-blocked FFT (power of two size at or above this uses blocked passes and blocked bit-reversal).
+// Below this, random access of bit-reversal (and N entries of its table) stays in L1/L2 cache, so that the table is faster.
+static const size_t BLOCKED_FFT_MIN_SIZE = 16384;
+
+// Once radix-2^2 block size is this or less, remaining passes are computed block by block (2 * 16384 floats = 128 KiB fits in L2)
+static const size_t BLOCKED_FFT_BLOCK_SIZE = 16384;
+
+// Blocked bit-reversal moves 16 x 16 tiles (16 floats = 64 bytes cache line)
+static const int BIT_REVERSE_TILE_BITS = 4;
+static const size_t BIT_REVERSE_TILE_SIZE = 16;
+
+// Twiddle factors and bit-reversal permutation are computed once per size,
+// so that `FFT` and `IFFT` only perform loads and multiply-adds.
+// `pass_twiddle_reals` and `pass_twiddle_imags` store W^{j}, W^{2j}, W^{3j} of each radix-4 pass contiguously,
+// so that SIMD can load 4 twiddle factors at once.
+// If size is not power of two, size is decomposed into `factors` (`number_of_factors` > 0),
+// and `work_reals` and `work_imags` are used as ping-pong buffers of Stockham autosort.
+// If size is `BLOCKED_FFT_MIN_SIZE` or more, `indexes` has bit-reversal of the middle log2(N) - 8 bits only (see `blocked_bit_reverse`).
+// Both plans transform `INTERLEAVED` batch per channel, `channel_reals` and `channel_imags` hold the deinterleaved channel.
+typedef struct {
+  size_t size;
+  int number_of_stages;
+  float *twiddle_reals;
+  float *twiddle_imags;
+  float *pass_twiddle_reals;
+  float *pass_twiddle_imags;
+  size_t *indexes;
+  int number_of_factors;
+  size_t factors[MAX_NUMBER_OF_FACTORS];
+  float *work_reals;
+  float *work_imags;
+  float *channel_reals;
+  float *channel_imags;
+} FFT_PLAN;
+
+// Memory layout of multiple channels (or frames) for batched transform
+//   PLANAR      ... channel 0 (N elements), channel 1 (N elements), ... (SIMD runs within each channel, suited to 1 - 3 channels)
+//   INTERLEAVED ... element 0 of every channel, element 1 of every channel, ... (SIMD runs across channels, suited to 4 or more channels)
+typedef enum {
+  PLANAR,
+  INTERLEAVED
+} BATCH_LAYOUT;
+
+// N-point real FFT computed by N/2-point complex FFT.
+// Spectrum has N/2 + 1 bins (from DC to Nyquist), the rest is conjugate symmetric.
+typedef struct {
+  size_t size;
+  FFT_PLAN *fft_plan;
+  float *twiddle_reals;
+  float *twiddle_imags;
+} RFFT_PLAN;
+
+// 2^{n}
+static inline int pow2(const int n) {
+  if (n == 0) {
+    return 1;
+  }
+
+  return 2 << (n - 1);
+}
+
+static inline void swap(float *const reals, float *const imags, const size_t i, const size_t k) {
+  float tmp_real;
+  float tmp_imag;
+
+  tmp_real = reals[i];
+  tmp_imag = imags[i];
+
+  reals[i] = reals[k];
+  imags[i] = imags[k];
+
+  reals[k] = tmp_real;
+  imags[k] = tmp_imag;
+}
+
+// Block size of the first radix-4 pass (if log2(N) is odd, the first stage is radix-2)
+static inline size_t first_radix4_block_size(const FFT_PLAN *plan) {
+  if (plan->number_of_stages & 0x00000001) {
+    return plan->size / 2;
+  }
+
+  return plan->size;
+}
+
+// Partially created plan (e.g., allocation failure in `create_fft_plan`) is destroyed as well
+static inline void destroy_fft_plan(FFT_PLAN *plan) {
+  if (plan == nullptr) {
+    return;
+  }
+
+  free(plan->twiddle_reals);
+  free(plan->twiddle_imags);
+  free(plan->pass_twiddle_reals);
+  free(plan->pass_twiddle_imags);
+  free(plan->indexes);
+  free(plan->work_reals);
+  free(plan->work_imags);
+  free(plan->channel_reals);
+  free(plan->channel_imags);
+  free(plan);
+}
+
+// Returns `nullptr` if size has prime factor that is neither 2, 3 nor 5 (or memory cannot be allocated)
+static inline FFT_PLAN *create_fft_plan(const size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+
+  FFT_PLAN *plan = (FFT_PLAN *)calloc(1, sizeof(FFT_PLAN));
+
+  if (plan == nullptr) {
+    return nullptr;
+  }
+
+  plan->size = size;
+
+  // W^{k} = cos((2 * PI * k) / N) -/+ j * sin((2 * PI * k) / N) (0 <= k < 3N / 4 for radix-4, 0 <= k < N for mixed-radix)
+  plan->twiddle_reals = (float *)calloc(size, sizeof(float));
+  plan->twiddle_imags = (float *)calloc(size, sizeof(float));
+
+  if ((plan->twiddle_reals == nullptr) || (plan->twiddle_imags == nullptr)) {
+    destroy_fft_plan(plan);
+    return nullptr;
+  }
+
+  for (size_t k = 0; k < size; k++) {
+    plan->twiddle_reals[k] = cosf((2.0f * M_PI * k) / size);
+    plan->twiddle_imags[k] = sinf((2.0f * M_PI * k) / size);
+  }
+
+  if ((size & (size - 1)) != 0) {
+    static const size_t radixes[] = { 4, 2, 3, 5 };
+
+    size_t rest = size;
+
+    for (size_t radix : radixes) {
+      while (((rest % radix) == 0) && (plan->number_of_factors < MAX_NUMBER_OF_FACTORS)) {
+        plan->factors[plan->number_of_factors++] = radix;
+
+        rest /= radix;
+      }
+    }
+
+    if (rest != 1) {
+      destroy_fft_plan(plan);
+      return nullptr;
+    }
+
+    plan->work_reals    = (float *)calloc(size, sizeof(float));
+    plan->work_imags    = (float *)calloc(size, sizeof(float));
+    plan->channel_reals = (float *)calloc(size, sizeof(float));
+    plan->channel_imags = (float *)calloc(size, sizeof(float));
+
+    if ((plan->work_reals == nullptr) || (plan->work_imags == nullptr) || (plan->channel_reals == nullptr) || (plan->channel_imags == nullptr)) {
+      destroy_fft_plan(plan);
+      return nullptr;
+    }
+
+    return plan;
+  }
+
+  int number_of_stages = (int)log2f((float)size);
+
+  plan->number_of_stages = number_of_stages;
+
+  // Sum of 3 * (N/4 + N/16 + ...) is less than N
+  plan->pass_twiddle_reals = (float *)calloc(size, sizeof(float));
+  plan->pass_twiddle_imags = (float *)calloc(size, sizeof(float));
+
+  if ((plan->pass_twiddle_reals == nullptr) || (plan->pass_twiddle_imags == nullptr)) {
+    destroy_fft_plan(plan);
+    return nullptr;
+  }
+
+  size_t offset = 0;
+
+  for (size_t block_size = first_radix4_block_size(plan); block_size >= 4; block_size /= 4) {
+    const size_t quarter_block_size = block_size / 4;
+
+    const size_t stride = size / block_size;
+
+    for (size_t p = 1; p <= 3; p++) {
+      for (size_t j = 0; j < quarter_block_size; j++) {
+        plan->pass_twiddle_reals[offset + j] = plan->twiddle_reals[p * stride * j];
+        plan->pass_twiddle_imags[offset + j] = plan->twiddle_imags[p * stride * j];
+      }
+
+      offset += quarter_block_size;
+    }
+  }
+
+  if (size >= BLOCKED_FFT_MIN_SIZE) {
+    const int number_of_middle_bits = number_of_stages - (2 * BIT_REVERSE_TILE_BITS);
+
+    const size_t number_of_tiles = (size_t)pow2(number_of_middle_bits);
+
+    plan->indexes       = (size_t *)calloc(number_of_tiles, sizeof(size_t));
+    plan->channel_reals = (float *)calloc(size, sizeof(float));
+    plan->channel_imags = (float *)calloc(size, sizeof(float));
+
+    if ((plan->indexes == nullptr) || (plan->channel_reals == nullptr) || (plan->channel_imags == nullptr)) {
+      destroy_fft_plan(plan);
+      return nullptr;
+    }
+
+    for (size_t b = 0; b < number_of_tiles; b++) {
+      for (int bit = 0; bit < number_of_middle_bits; bit++) {
+        if (b & ((size_t)1 << bit)) {
+          plan->indexes[b] |= (size_t)1 << (number_of_middle_bits - 1 - bit);
+        }
+      }
+    }
+
+    return plan;
+  }
+
+  plan->indexes = (size_t *)calloc(size, sizeof(size_t));
+
+  if (plan->indexes == nullptr) {
+    destroy_fft_plan(plan);
+    return nullptr;
+  }
+
+  for (int stage = 1; stage <= number_of_stages; stage++) {
+    int rest = number_of_stages - stage;
+
+    for (int i = 0; i < pow2(stage - 1); i++) {
+      plan->indexes[pow2(stage - 1) + i] = plan->indexes[i] + pow2(rest);
+    }
+  }
+
+  return plan;
+}
+
+static inline void bit_reverse(const FFT_PLAN *plan, float *const reals, float *const imags) {
+  const size_t size = plan->size;
+
+  const size_t *indexes = plan->indexes;
+
+  for (size_t k = 0; k < size; k++) {
+    if (indexes[k] <= k) {
+      continue;
+    }
+
+    swap(reals, imags, indexes[k], k);
+  }
+}
+
+// Bit-reversal without random access (n = a * 2^{log2(N) - 4} + b * 16 + c, a and c are 4 bits).
+//   rev(n) = rev(c) * 2^{log2(N) - 4} + rev(b) * 16 + rev(a)
+// So that the 16 x 16 tile of `b` is moved to the tile of rev(b) (transposed, and every row is a cache line),
+// tiles of `b` and rev(b) are swapped through buffers.
+static inline void blocked_bit_reverse(const FFT_PLAN *plan, float *const reals, float *const imags) {
+  static const size_t tile_indexes[BIT_REVERSE_TILE_SIZE] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+
+  const size_t number_of_tiles = plan->size / (BIT_REVERSE_TILE_SIZE * BIT_REVERSE_TILE_SIZE);
+
+  const size_t stride = plan->size / BIT_REVERSE_TILE_SIZE;
+
+  const size_t *indexes = plan->indexes;
+
+  float tile_reals[2][BIT_REVERSE_TILE_SIZE * BIT_REVERSE_TILE_SIZE];
+  float tile_imags[2][BIT_REVERSE_TILE_SIZE * BIT_REVERSE_TILE_SIZE];
+
+  for (size_t b = 0; b < number_of_tiles; b++) {
+    const size_t bs[2] = { b, indexes[b] };
+
+    if (bs[1] < bs[0]) {
+      continue;
+    }
+
+    for (int t = 0; t < 2; t++) {
+      for (size_t a = 0; a < BIT_REVERSE_TILE_SIZE; a++) {
+        const size_t offset = (a * stride) + (bs[t] * BIT_REVERSE_TILE_SIZE);
+
+        for (size_t c = 0; c < BIT_REVERSE_TILE_SIZE; c++) {
+          tile_reals[t][(a * BIT_REVERSE_TILE_SIZE) + c] = reals[offset + c];
+          tile_imags[t][(a * BIT_REVERSE_TILE_SIZE) + c] = imags[offset + c];
+        }
+      }
+    }
+
+    for (int t = 0; t < 2; t++) {
+      for (size_t c = 0; c < BIT_REVERSE_TILE_SIZE; c++) {
+        const size_t offset = (tile_indexes[c] * stride) + (bs[1 - t] * BIT_REVERSE_TILE_SIZE);
+
+        for (size_t a = 0; a < BIT_REVERSE_TILE_SIZE; a++) {
+          reals[offset + tile_indexes[a]] = tile_reals[t][(a * BIT_REVERSE_TILE_SIZE) + c];
+          imags[offset + tile_indexes[a]] = tile_imags[t][(a * BIT_REVERSE_TILE_SIZE) + c];
+        }
+      }
+    }
+  }
+}
+
+// Butterfly of radix-2 decimation-in-frequency (`w_imag` is already multiplied by sign)
+static inline void radix2_butterfly(float *const reals, float *const imags, const size_t n, const size_t half_block_size, const float w_real, const float w_imag) {
+  const size_t m = half_block_size + n;
+
+  const float e_real = reals[n];
+  const float e_imag = imags[n];
+  const float o_real = reals[m];
+  const float o_imag = imags[m];
+
+  reals[n] = e_real + o_real;
+  imags[n] = e_imag + o_imag;
+  reals[m] = (w_real * (e_real - o_real)) - (w_imag * (e_imag - o_imag));
+  imags[m] = (w_real * (e_imag - o_imag)) + (w_imag * (e_real - o_real));
+}
+
+#ifdef DSP_SIMD
+// `SIMD::lanes` butterflies of radix-2 per instruction (from `j` to `half_block_size`)
+template <typename SIMD>
+static inline size_t simd_radix2_butterflies(float *const reals, float *const imags, const size_t half_block_size, const float *twiddle_reals, const float *twiddle_imags, const float sign, size_t j) {
+  typedef typename SIMD::type V;
+
+  const V v_sign = SIMD::splat(sign);
+
+  for (; (j + SIMD::lanes) <= half_block_size; j += SIMD::lanes) {
+    size_t n = j;
+    size_t m = half_block_size + n;
+
+    V e_real = SIMD::load(&reals[n]);
+    V e_imag = SIMD::load(&imags[n]);
+    V o_real = SIMD::load(&reals[m]);
+    V o_imag = SIMD::load(&imags[m]);
+    V w_real = SIMD::load(&twiddle_reals[j]);
+    V w_imag = SIMD::mul(v_sign, SIMD::load(&twiddle_imags[j]));
+
+    V d_real = SIMD::sub(e_real, o_real);
+    V d_imag = SIMD::sub(e_imag, o_imag);
+
+    SIMD::store(&reals[n], SIMD::add(e_real, o_real));
+    SIMD::store(&imags[n], SIMD::add(e_imag, o_imag));
+    SIMD::store(&reals[m], SIMD::sub(SIMD::mul(w_real, d_real), SIMD::mul(w_imag, d_imag)));
+    SIMD::store(&imags[m], SIMD::add(SIMD::mul(w_real, d_imag), SIMD::mul(w_imag, d_real)));
+  }
+
+  return j;
+}
+#endif
+
+// First stage of odd log2(N) (N/2 butterflies of radix-2)
+static inline void radix2_butterflies(const FFT_PLAN *plan, float *const reals, float *const imags, const float sign) {
+  const size_t half_block_size = plan->size / 2;
+
+  const float *twiddle_reals = plan->twiddle_reals;
+  const float *twiddle_imags = plan->twiddle_imags;
+
+  size_t j = 0;
+
+#ifdef DSP_SIMD_AVX
+  j = simd_radix2_butterflies<F32X8>(reals, imags, half_block_size, twiddle_reals, twiddle_imags, sign, j);
+#endif
+
+#ifdef DSP_SIMD
+  j = simd_radix2_butterflies<F32X4>(reals, imags, half_block_size, twiddle_reals, twiddle_imags, sign, j);
+#endif
+
+  for (; j < half_block_size; j++) {
+    radix2_butterfly(reals, imags, j, half_block_size, twiddle_reals[j], sign * twiddle_imags[j]);
+  }
+}
+
+// Radix-2^2 decimation-in-frequency butterfly (radix-4 butterfly that keeps bit-reversed order of radix-2)
+//   x[j]      = (a + c) + (b + d)
+//   x[j + q]  = ((a + c) - (b + d)) * W^{2j}
+//   x[j + 2q] = ((a - c) + (b - d) * W^{N/4}) * W^{j}
+//   x[j + 3q] = ((a - c) - (b - d) * W^{N/4}) * W^{3j}
+// (`w1_imag`, `w2_imag`, `w3_imag` are already multiplied by sign)
+static inline void radix4_butterfly(float *const reals, float *const imags, const size_t n0, const size_t quarter_block_size, const float w1_real, const float w1_imag, const float w2_real, const float w2_imag, const float w3_real, const float w3_imag, const float sign) {
+  const size_t n1 = n0 + quarter_block_size;
+  const size_t n2 = n1 + quarter_block_size;
+  const size_t n3 = n2 + quarter_block_size;
+
+  const float a_real = reals[n0];
+  const float a_imag = imags[n0];
+  const float b_real = reals[n1];
+  const float b_imag = imags[n1];
+  const float c_real = reals[n2];
+  const float c_imag = imags[n2];
+  const float d_real = reals[n3];
+  const float d_imag = imags[n3];
+
+  const float t0_real = a_real + c_real;
+  const float t0_imag = a_imag + c_imag;
+  const float t1_real = b_real + d_real;
+  const float t1_imag = b_imag + d_imag;
+  const float t2_real = a_real - c_real;
+  const float t2_imag = a_imag - c_imag;
+
+  // (b - d) * W^{N/4} = (b - d) * (-/+ j)
+  const float t3_real = 0.0f - (sign * (b_imag - d_imag));
+  const float t3_imag = sign * (b_real - d_real);
+
+  const float y1_real = t0_real - t1_real;
+  const float y1_imag = t0_imag - t1_imag;
+  const float y2_real = t2_real + t3_real;
+  const float y2_imag = t2_imag + t3_imag;
+  const float y3_real = t2_real - t3_real;
+  const float y3_imag = t2_imag - t3_imag;
+
+  reals[n0] = t0_real + t1_real;
+  imags[n0] = t0_imag + t1_imag;
+  reals[n1] = (w2_real * y1_real) - (w2_imag * y1_imag);
+  imags[n1] = (w2_real * y1_imag) + (w2_imag * y1_real);
+  reals[n2] = (w1_real * y2_real) - (w1_imag * y2_imag);
+  imags[n2] = (w1_real * y2_imag) + (w1_imag * y2_real);
+  reals[n3] = (w3_real * y3_real) - (w3_imag * y3_imag);
+  imags[n3] = (w3_real * y3_imag) + (w3_imag * y3_real);
+}
+
+static inline void scalar_radix4_butterflies(float *const reals, float *const imags, const size_t size, const size_t block_size, const float *w1_reals, const float *w1_imags, const float sign) {
+  const size_t quarter_block_size = block_size / 4;
+
+  const float *w2_reals = w1_reals + quarter_block_size;
+  const float *w2_imags = w1_imags + quarter_block_size;
+  const float *w3_reals = w2_reals + quarter_block_size;
+  const float *w3_imags = w2_imags + quarter_block_size;
+
+  for (size_t i = 0; i < size; i += block_size) {
+    for (size_t j = 0; j < quarter_block_size; j++) {
+      radix4_butterfly(reals, imags, (i + j), quarter_block_size, w1_reals[j], (sign * w1_imags[j]), w2_reals[j], (sign * w2_imags[j]), w3_reals[j], (sign * w3_imags[j]), sign);
+    }
+  }
+}
+
+#ifdef DSP_SIMD
+// Radix-2^2 butterflies on vectors (`a`, `b`, `c`, `d` are overwritten by x[j], x[j + q], x[j + 2q], x[j + 3q] before twiddle)
+template <typename SIMD>
+static inline void radix4_kernel(typename SIMD::type &a_real, typename SIMD::type &a_imag, typename SIMD::type &b_real, typename SIMD::type &b_imag, typename SIMD::type &c_real, typename SIMD::type &c_imag, typename SIMD::type &d_real, typename SIMD::type &d_imag, const typename SIMD::type v_sign) {
+  typedef typename SIMD::type V;
+
+  V t0_real = SIMD::add(a_real, c_real);
+  V t0_imag = SIMD::add(a_imag, c_imag);
+  V t1_real = SIMD::add(b_real, d_real);
+  V t1_imag = SIMD::add(b_imag, d_imag);
+  V t2_real = SIMD::sub(a_real, c_real);
+  V t2_imag = SIMD::sub(a_imag, c_imag);
+  V t3_real = SIMD::mul(v_sign, SIMD::sub(d_imag, b_imag));
+  V t3_imag = SIMD::mul(v_sign, SIMD::sub(b_real, d_real));
+
+  a_real = SIMD::add(t0_real, t1_real);
+  a_imag = SIMD::add(t0_imag, t1_imag);
+  b_real = SIMD::sub(t0_real, t1_real);
+  b_imag = SIMD::sub(t0_imag, t1_imag);
+  c_real = SIMD::add(t2_real, t3_real);
+  c_imag = SIMD::add(t2_imag, t3_imag);
+  d_real = SIMD::sub(t2_real, t3_real);
+  d_imag = SIMD::sub(t2_imag, t3_imag);
+}
+
+// x * w (`w_imag` is already multiplied by sign)
+template <typename SIMD>
+static inline void complex_multiply(typename SIMD::type &x_real, typename SIMD::type &x_imag, const typename SIMD::type w_real, const typename SIMD::type w_imag) {
+  typedef typename SIMD::type V;
+
+  V real = SIMD::sub(SIMD::mul(w_real, x_real), SIMD::mul(w_imag, x_imag));
+  V imag = SIMD::add(SIMD::mul(w_real, x_imag), SIMD::mul(w_imag, x_real));
+
+  x_real = real;
+  x_imag = imag;
+}
+
+template <typename SIMD>
+static inline void twiddle(typename SIMD::type &x_real, typename SIMD::type &x_imag, const float *const w_reals, const float *const w_imags, const typename SIMD::type v_sign) {
+  complex_multiply<SIMD>(x_real, x_imag, SIMD::load(w_reals), SIMD::mul(v_sign, SIMD::load(w_imags)));
+}
+
+// `SIMD::lanes` butterflies (contiguous `j`) per instruction on passes that quarter block size is `SIMD::lanes` or more
+template <typename SIMD>
+static inline void simd_radix4_butterflies(float *const reals, float *const imags, const size_t size, const size_t block_size, const float *w1_reals, const float *w1_imags, const float sign) {
+  typedef typename SIMD::type V;
+
+  const size_t quarter_block_size = block_size / 4;
+
+  const float *w2_reals = w1_reals + quarter_block_size;
+  const float *w2_imags = w1_imags + quarter_block_size;
+  const float *w3_reals = w2_reals + quarter_block_size;
+  const float *w3_imags = w2_imags + quarter_block_size;
+
+  const V v_sign = SIMD::splat(sign);
+
+  for (size_t i = 0; i < size; i += block_size) {
+    for (size_t j = 0; j < quarter_block_size; j += SIMD::lanes) {
+      size_t n0 = i + j;
+      size_t n1 = n0 + quarter_block_size;
+      size_t n2 = n1 + quarter_block_size;
+      size_t n3 = n2 + quarter_block_size;
+
+      V a_real = SIMD::load(&reals[n0]);
+      V a_imag = SIMD::load(&imags[n0]);
+      V b_real = SIMD::load(&reals[n1]);
+      V b_imag = SIMD::load(&imags[n1]);
+      V c_real = SIMD::load(&reals[n2]);
+      V c_imag = SIMD::load(&imags[n2]);
+      V d_real = SIMD::load(&reals[n3]);
+      V d_imag = SIMD::load(&imags[n3]);
+
+      radix4_kernel<SIMD>(a_real, a_imag, b_real, b_imag, c_real, c_imag, d_real, d_imag, v_sign);
+
+      twiddle<SIMD>(b_real, b_imag, &w2_reals[j], &w2_imags[j], v_sign);
+      twiddle<SIMD>(c_real, c_imag, &w1_reals[j], &w1_imags[j], v_sign);
+      twiddle<SIMD>(d_real, d_imag, &w3_reals[j], &w3_imags[j], v_sign);
+
+      SIMD::store(&reals[n0], a_real);
+      SIMD::store(&imags[n0], a_imag);
+      SIMD::store(&reals[n1], b_real);
+      SIMD::store(&imags[n1], b_imag);
+      SIMD::store(&reals[n2], c_real);
+      SIMD::store(&imags[n2], c_imag);
+      SIMD::store(&reals[n3], d_real);
+      SIMD::store(&imags[n3], d_imag);
+    }
+  }
+}
+
+// The last pass (4-point DFT on each 4 contiguous elements) is computed on 4 x 4 transposed vectors
+static inline void simd_last_radix4_butterflies(float *const reals, float *const imags, const size_t size, const float sign) {
+  typedef F32X4::type V;
+
+  const V v_sign = F32X4::splat(sign);
+
+  for (size_t n = 0; n < size; n += 16) {
+    V x0_real = F32X4::load(&reals[n +  0]);
+    V x1_real = F32X4::load(&reals[n +  4]);
+    V x2_real = F32X4::load(&reals[n +  8]);
+    V x3_real = F32X4::load(&reals[n + 12]);
+    V x0_imag = F32X4::load(&imags[n +  0]);
+    V x1_imag = F32X4::load(&imags[n +  4]);
+    V x2_imag = F32X4::load(&imags[n +  8]);
+    V x3_imag = F32X4::load(&imags[n + 12]);
+
+    F32X4::transpose(x0_real, x1_real, x2_real, x3_real);
+    F32X4::transpose(x0_imag, x1_imag, x2_imag, x3_imag);
+
+    radix4_kernel<F32X4>(x0_real, x0_imag, x1_real, x1_imag, x2_real, x2_imag, x3_real, x3_imag, v_sign);
+
+    F32X4::transpose(x0_real, x1_real, x2_real, x3_real);
+    F32X4::transpose(x0_imag, x1_imag, x2_imag, x3_imag);
+
+    F32X4::store(&reals[n +  0], x0_real);
+    F32X4::store(&reals[n +  4], x1_real);
+    F32X4::store(&reals[n +  8], x2_real);
+    F32X4::store(&reals[n + 12], x3_real);
+    F32X4::store(&imags[n +  0], x0_imag);
+    F32X4::store(&imags[n +  4], x1_imag);
+    F32X4::store(&imags[n +  8], x2_imag);
+    F32X4::store(&imags[n + 12], x3_imag);
+  }
+}
+#endif
+
+// Stockham autosort pass of radix-p (p = 2, 3, 4, 5) for mixed-radix sizes (e.g., 480, 960, 1920).
+//   y[k + s * (p * q + u)] = W^{s * q * u} * sum_{r} x[k + s * (q + r * m)] * W_p^{r * u}
+// (n = N / s, m = n / p, 0 <= q < m, 0 <= k < s), so that output is in natural order without bit-reversal.
+static inline void stockham_butterflies(const FFT_PLAN *plan, const size_t radix, const size_t n, const size_t s, const float *const x_reals, const float *const x_imags, float *const y_reals, float *const y_imags, const float sign) {
+  // cos(2 * PI / 3), sin(2 * PI / 3), cos(2 * PI / 5), sin(2 * PI / 5), cos(4 * PI / 5), sin(4 * PI / 5)
+  static const float c3_1 = -0.5f;
+  static const float s3_1 = 0.86602540378443864676f;
+  static const float c5_1 = 0.30901699437494742410f;
+  static const float s5_1 = 0.95105651629515357212f;
+  static const float c5_2 = -0.80901699437494742410f;
+  static const float s5_2 = 0.58778525229247312917f;
+
+  const size_t m = n / radix;
+
+  const float *twiddle_reals = plan->twiddle_reals;
+  const float *twiddle_imags = plan->twiddle_imags;
+
+  float a_reals[5];
+  float a_imags[5];
+  float b_reals[5];
+  float b_imags[5];
+
+  for (size_t q = 0; q < m; q++) {
+    for (size_t k = 0; k < s; k++) {
+      for (size_t r = 0; r < radix; r++) {
+        a_reals[r] = x_reals[k + (s * (q + (r * m)))];
+        a_imags[r] = x_imags[k + (s * (q + (r * m)))];
+      }
+
+      switch (radix) {
+        case 2: {
+          b_reals[0] = a_reals[0] + a_reals[1];
+          b_imags[0] = a_imags[0] + a_imags[1];
+          b_reals[1] = a_reals[0] - a_reals[1];
+          b_imags[1] = a_imags[0] - a_imags[1];
+          break;
+        }
+
+        case 3: {
+          float t_real = a_reals[1] + a_reals[2];
+          float t_imag = a_imags[1] + a_imags[2];
+          float d_real = a_reals[1] - a_reals[2];
+          float d_imag = a_imags[1] - a_imags[2];
+
+          float c_real = a_reals[0] + (c3_1 * t_real);
+          float c_imag = a_imags[0] + (c3_1 * t_imag);
+
+          // (-/+ j) * sin(2 * PI / 3) * d
+          float s_real = 0.0f - (sign * s3_1 * d_imag);
+          float s_imag = sign * s3_1 * d_real;
+
+          b_reals[0] = a_reals[0] + t_real;
+          b_imags[0] = a_imags[0] + t_imag;
+          b_reals[1] = c_real + s_real;
+          b_imags[1] = c_imag + s_imag;
+          b_reals[2] = c_real - s_real;
+          b_imags[2] = c_imag - s_imag;
+          break;
+        }
+
+        case 4: {
+          float t0_real = a_reals[0] + a_reals[2];
+          float t0_imag = a_imags[0] + a_imags[2];
+          float t1_real = a_reals[1] + a_reals[3];
+          float t1_imag = a_imags[1] + a_imags[3];
+          float t2_real = a_reals[0] - a_reals[2];
+          float t2_imag = a_imags[0] - a_imags[2];
+
+          // (a1 - a3) * (-/+ j)
+          float t3_real = 0.0f - (sign * (a_imags[1] - a_imags[3]));
+          float t3_imag = sign * (a_reals[1] - a_reals[3]);
+
+          b_reals[0] = t0_real + t1_real;
+          b_imags[0] = t0_imag + t1_imag;
+          b_reals[1] = t2_real + t3_real;
+          b_imags[1] = t2_imag + t3_imag;
+          b_reals[2] = t0_real - t1_real;
+          b_imags[2] = t0_imag - t1_imag;
+          b_reals[3] = t2_real - t3_real;
+          b_imags[3] = t2_imag - t3_imag;
+          break;
+        }
+
+        case 5: {
+          float t1_real = a_reals[1] + a_reals[4];
+          float t1_imag = a_imags[1] + a_imags[4];
+          float t2_real = a_reals[2] + a_reals[3];
+          float t2_imag = a_imags[2] + a_imags[3];
+          float d1_real = a_reals[1] - a_reals[4];
+          float d1_imag = a_imags[1] - a_imags[4];
+          float d2_real = a_reals[2] - a_reals[3];
+          float d2_imag = a_imags[2] - a_imags[3];
+
+          float c1_real = a_reals[0] + (c5_1 * t1_real) + (c5_2 * t2_real);
+          float c1_imag = a_imags[0] + (c5_1 * t1_imag) + (c5_2 * t2_imag);
+          float c2_real = a_reals[0] + (c5_2 * t1_real) + (c5_1 * t2_real);
+          float c2_imag = a_imags[0] + (c5_2 * t1_imag) + (c5_1 * t2_imag);
+
+          // (-/+ j) * (sin(2 * PI / 5) * d1 + sin(4 * PI / 5) * d2), (-/+ j) * (sin(4 * PI / 5) * d1 - sin(2 * PI / 5) * d2)
+          float s1_real = 0.0f - (sign * ((s5_1 * d1_imag) + (s5_2 * d2_imag)));
+          float s1_imag = sign * ((s5_1 * d1_real) + (s5_2 * d2_real));
+          float s2_real = 0.0f - (sign * ((s5_2 * d1_imag) - (s5_1 * d2_imag)));
+          float s2_imag = sign * ((s5_2 * d1_real) - (s5_1 * d2_real));
+
+          b_reals[0] = a_reals[0] + t1_real + t2_real;
+          b_imags[0] = a_imags[0] + t1_imag + t2_imag;
+          b_reals[1] = c1_real + s1_real;
+          b_imags[1] = c1_imag + s1_imag;
+          b_reals[2] = c2_real + s2_real;
+          b_imags[2] = c2_imag + s2_imag;
+          b_reals[3] = c2_real - s2_real;
+          b_imags[3] = c2_imag - s2_imag;
+          b_reals[4] = c1_real - s1_real;
+          b_imags[4] = c1_imag - s1_imag;
+          break;
+        }
+
+        default: {
+          break;
+        }
+      }
+
+      for (size_t u = 0; u < radix; u++) {
+        size_t r = s * q * u;
+
+        float w_real = twiddle_reals[r];
+        float w_imag = sign * twiddle_imags[r];
+
+        y_reals[k + (s * ((radix * q) + u))] = (w_real * b_reals[u]) - (w_imag * b_imags[u]);
+        y_imags[k + (s * ((radix * q) + u))] = (w_real * b_imags[u]) + (w_imag * b_reals[u]);
+      }
+    }
+  }
+}
+
+static inline void mixed_radix_butterflies(const FFT_PLAN *plan, float *const reals, float *const imags, const float sign) {
+  float *x_reals = reals;
+  float *x_imags = imags;
+  float *y_reals = plan->work_reals;
+  float *y_imags = plan->work_imags;
+
+  size_t n = plan->size;
+  size_t s = 1;
+
+  for (int i = 0; i < plan->number_of_factors; i++) {
+    const size_t radix = plan->factors[i];
+
+    stockham_butterflies(plan, radix, n, s, x_reals, x_imags, y_reals, y_imags, sign);
+
+    float *tmp_reals = x_reals;
+    float *tmp_imags = x_imags;
+
+    x_reals = y_reals;
+    x_imags = y_imags;
+    y_reals = tmp_reals;
+    y_imags = tmp_imags;
+
+    n /= radix;
+    s *= radix;
+  }
+
+  if (x_reals != reals) {
+    for (size_t k = 0; k < plan->size; k++) {
+      reals[k] = x_reals[k];
+      imags[k] = x_imags[k];
+    }
+  }
+}
+
+// A radix-2^2 pass on `size` elements (from `reals` and `imags`)
+static inline void radix4_butterflies(float *const reals, float *const imags, const size_t size, const size_t block_size, const float *w1_reals, const float *w1_imags, const float sign) {
+#ifdef DSP_SIMD
+  if ((block_size >= 16) && (size >= 16)) {
+#ifdef DSP_SIMD_AVX
+    if (block_size >= 32) {
+      simd_radix4_butterflies<F32X8>(reals, imags, size, block_size, w1_reals, w1_imags, sign);
+    } else {
+      simd_radix4_butterflies<F32X4>(reals, imags, size, block_size, w1_reals, w1_imags, sign);
+    }
+#else
+    simd_radix4_butterflies<F32X4>(reals, imags, size, block_size, w1_reals, w1_imags, sign);
+#endif
+  } else if (size >= 16) {
+    simd_last_radix4_butterflies(reals, imags, size, sign);
+  } else {
+    scalar_radix4_butterflies(reals, imags, size, block_size, w1_reals, w1_imags, sign);
+  }
+#else
+  scalar_radix4_butterflies(reals, imags, size, block_size, w1_reals, w1_imags, sign);
+#endif
+}
+
+// `sign` is -1 on forward transform and +1 on inverse transform (conjugate twiddle factors)
+static inline void butterflies(const FFT_PLAN *plan, float *const reals, float *const imags, const float sign) {
+  if (plan->number_of_factors > 0) {
+    mixed_radix_butterflies(plan, reals, imags, sign);
+    return;
+  }
+
+  if (plan->number_of_stages & 0x00000001) {
+    radix2_butterflies(plan, reals, imags, sign);
+  }
+
+  const size_t size = plan->size;
+
+  const float *pass_twiddle_reals = plan->pass_twiddle_reals;
+  const float *pass_twiddle_imags = plan->pass_twiddle_imags;
+
+  size_t block_size = first_radix4_block_size(plan);
+
+  // Passes of large blocks stream over the whole array
+  for (; (block_size >= 4) && ((size < BLOCKED_FFT_MIN_SIZE) || (block_size > BLOCKED_FFT_BLOCK_SIZE)); block_size /= 4) {
+    radix4_butterflies(reals, imags, size, block_size, pass_twiddle_reals, pass_twiddle_imags, sign);
+
+    pass_twiddle_reals += 3 * (block_size / 4);
+    pass_twiddle_imags += 3 * (block_size / 4);
+  }
+
+  // Remaining passes are completed on each block while it is in cache (twiddle factors of each pass are the same for every block)
+  if (block_size >= 4) {
+    for (size_t offset = 0; offset < size; offset += block_size) {
+      const float *w_reals = pass_twiddle_reals;
+      const float *w_imags = pass_twiddle_imags;
+
+      for (size_t b = block_size; b >= 4; b /= 4) {
+        radix4_butterflies(&reals[offset], &imags[offset], block_size, b, w_reals, w_imags, sign);
+
+        w_reals += 3 * (b / 4);
+        w_imags += 3 * (b / 4);
+      }
+    }
+  }
+
+  if (size >= BLOCKED_FFT_MIN_SIZE) {
+    blocked_bit_reverse(plan, reals, imags);
+  } else {
+    bit_reverse(plan, reals, imags);
+  }
+}
+
+static inline void FFT(const FFT_PLAN *plan, float *const reals, float *const imags) {
+  butterflies(plan, reals, imags, -1.0f);
+}
+
+#ifdef DSP_SIMD
+// Multiply from `k` to `size` by `scale` (`SIMD::lanes` elements per instruction)
+template <typename SIMD>
+static inline size_t simd_scale(const size_t size, const float scale, float *const reals, float *const imags, size_t k) {
+  const typename SIMD::type v_scale = SIMD::splat(scale);
+
+  for (; k < (size - (size % SIMD::lanes)); k += SIMD::lanes) {
+    SIMD::store(&reals[k], SIMD::mul(SIMD::load(&reals[k]), v_scale));
+    SIMD::store(&imags[k], SIMD::mul(SIMD::load(&imags[k]), v_scale));
+  }
+
+  return k;
+}
+#endif
+
+// Multiply `size` elements by `scale`
+static inline void scale_elements(const size_t size, const float scale, float *const reals, float *const imags) {
+  size_t k = 0;
+
+#ifdef DSP_SIMD_AVX
+  k = simd_scale<F32X8>(size, scale, reals, imags, k);
+#endif
+
+#ifdef DSP_SIMD
+  k = simd_scale<F32X4>(size, scale, reals, imags, k);
+#endif
+
+  for (; k < size; k++) {
+    reals[k] *= scale;
+    imags[k] *= scale;
+  }
+}
+
+// Divide by N after inverse butterflies
+static inline void normalize(const size_t size, float *const reals, float *const imags) {
+  scale_elements(size, (1.0f / size), reals, imags);
+}
+
+static inline void IFFT(const FFT_PLAN *plan, float *const reals, float *const imags) {
+  butterflies(plan, reals, imags, 1.0f);
+
+  normalize(plan->size, reals, imags);
+}
+
+#ifdef DSP_SIMD
+// Radix-2 butterfly of `SIMD::lanes` channels per instruction (from channel `c`, `n` and `half_block_size` are scaled by number of channels)
+template <typename SIMD>
+static inline size_t simd_interleaved_radix2_butterfly(float *const reals, float *const imags, const size_t number_of_channels, const size_t n, const size_t half_block_size, const float w_real, const float w_imag, size_t c) {
+  typedef typename SIMD::type V;
+
+  const V v_w_real = SIMD::splat(w_real);
+  const V v_w_imag = SIMD::splat(w_imag);
+
+  for (; (c + SIMD::lanes) <= number_of_channels; c += SIMD::lanes) {
+    const size_t e = n + c;
+    const size_t o = half_block_size + e;
+
+    V e_real = SIMD::load(&reals[e]);
+    V e_imag = SIMD::load(&imags[e]);
+    V o_real = SIMD::load(&reals[o]);
+    V o_imag = SIMD::load(&imags[o]);
+
+    V d_real = SIMD::sub(e_real, o_real);
+    V d_imag = SIMD::sub(e_imag, o_imag);
+
+    complex_multiply<SIMD>(d_real, d_imag, v_w_real, v_w_imag);
+
+    SIMD::store(&reals[e], SIMD::add(e_real, o_real));
+    SIMD::store(&imags[e], SIMD::add(e_imag, o_imag));
+    SIMD::store(&reals[o], d_real);
+    SIMD::store(&imags[o], d_imag);
+  }
+
+  return c;
+}
+
+// Radix-2^2 butterfly of `SIMD::lanes` channels per instruction (every channel shares twiddle factors)
+template <typename SIMD>
+static inline size_t simd_interleaved_radix4_butterfly(float *const reals, float *const imags, const size_t number_of_channels, const size_t n0, const size_t quarter_block_size, const float w1_real, const float w1_imag, const float w2_real, const float w2_imag, const float w3_real, const float w3_imag, const float sign, size_t c) {
+  typedef typename SIMD::type V;
+
+  const V v_sign = SIMD::splat(sign);
+
+  for (; (c + SIMD::lanes) <= number_of_channels; c += SIMD::lanes) {
+    const size_t m0 = n0 + c;
+    const size_t m1 = m0 + quarter_block_size;
+    const size_t m2 = m1 + quarter_block_size;
+    const size_t m3 = m2 + quarter_block_size;
+
+    V a_real = SIMD::load(&reals[m0]);
+    V a_imag = SIMD::load(&imags[m0]);
+    V b_real = SIMD::load(&reals[m1]);
+    V b_imag = SIMD::load(&imags[m1]);
+    V c_real = SIMD::load(&reals[m2]);
+    V c_imag = SIMD::load(&imags[m2]);
+    V d_real = SIMD::load(&reals[m3]);
+    V d_imag = SIMD::load(&imags[m3]);
+
+    radix4_kernel<SIMD>(a_real, a_imag, b_real, b_imag, c_real, c_imag, d_real, d_imag, v_sign);
+
+    complex_multiply<SIMD>(b_real, b_imag, SIMD::splat(w2_real), SIMD::splat(w2_imag));
+    complex_multiply<SIMD>(c_real, c_imag, SIMD::splat(w1_real), SIMD::splat(w1_imag));
+    complex_multiply<SIMD>(d_real, d_imag, SIMD::splat(w3_real), SIMD::splat(w3_imag));
+
+    SIMD::store(&reals[m0], a_real);
+    SIMD::store(&imags[m0], a_imag);
+    SIMD::store(&reals[m1], b_real);
+    SIMD::store(&imags[m1], b_imag);
+    SIMD::store(&reals[m2], c_real);
+    SIMD::store(&imags[m2], c_imag);
+    SIMD::store(&reals[m3], d_real);
+    SIMD::store(&imags[m3], d_imag);
+  }
+
+  return c;
+}
+#endif
+
+// Radix-2^2 FFT on interleaved channels (element n of channel c is [n * C + c]).
+// Each SIMD lane computes the same butterfly of a different channel, so that 4 (or 8) channels share an instruction and a cache line.
+static inline void interleaved_butterflies(const FFT_PLAN *plan, float *const reals, float *const imags, const size_t number_of_channels, const float sign) {
+  const size_t size = plan->size;
+
+  const size_t channels = number_of_channels;
+
+  if (plan->number_of_stages & 0x00000001) {
+    const size_t half_block_size = size / 2;
+
+    for (size_t j = 0; j < half_block_size; j++) {
+      const float w_real = plan->twiddle_reals[j];
+      const float w_imag = sign * plan->twiddle_imags[j];
+
+      size_t c = 0;
+
+#ifdef DSP_SIMD_AVX
+      c = simd_interleaved_radix2_butterfly<F32X8>(reals, imags, channels, (j * channels), (half_block_size * channels), w_real, w_imag, c);
+#endif
+
+#ifdef DSP_SIMD
+      c = simd_interleaved_radix2_butterfly<F32X4>(reals, imags, channels, (j * channels), (half_block_size * channels), w_real, w_imag, c);
+#endif
+
+      for (; c < channels; c++) {
+        radix2_butterfly(reals, imags, ((j * channels) + c), (half_block_size * channels), w_real, w_imag);
+      }
+    }
+  }
+
+  const float *w1_reals = plan->pass_twiddle_reals;
+  const float *w1_imags = plan->pass_twiddle_imags;
+
+  for (size_t block_size = first_radix4_block_size(plan); block_size >= 4; block_size /= 4) {
+    const size_t quarter_block_size = block_size / 4;
+
+    const float *w2_reals = w1_reals + quarter_block_size;
+    const float *w2_imags = w1_imags + quarter_block_size;
+    const float *w3_reals = w2_reals + quarter_block_size;
+    const float *w3_imags = w2_imags + quarter_block_size;
+
+    for (size_t i = 0; i < size; i += block_size) {
+      for (size_t j = 0; j < quarter_block_size; j++) {
+        const size_t n0 = (i + j) * channels;
+        const size_t q  = quarter_block_size * channels;
+
+        const float w1_real = w1_reals[j];
+        const float w1_imag = sign * w1_imags[j];
+        const float w2_real = w2_reals[j];
+        const float w2_imag = sign * w2_imags[j];
+        const float w3_real = w3_reals[j];
+        const float w3_imag = sign * w3_imags[j];
+
+        size_t c = 0;
+
+#ifdef DSP_SIMD_AVX
+        c = simd_interleaved_radix4_butterfly<F32X8>(reals, imags, channels, n0, q, w1_real, w1_imag, w2_real, w2_imag, w3_real, w3_imag, sign, c);
+#endif
+
+#ifdef DSP_SIMD
+        c = simd_interleaved_radix4_butterfly<F32X4>(reals, imags, channels, n0, q, w1_real, w1_imag, w2_real, w2_imag, w3_real, w3_imag, sign, c);
+#endif
+
+        for (; c < channels; c++) {
+          radix4_butterfly(reals, imags, (n0 + c), q, w1_real, w1_imag, w2_real, w2_imag, w3_real, w3_imag, sign);
+        }
+      }
+    }
+
+    w1_reals += 3 * quarter_block_size;
+    w1_imags += 3 * quarter_block_size;
+  }
+
+  const size_t *indexes = plan->indexes;
+
+  for (size_t k = 0; k < size; k++) {
+    if (indexes[k] <= k) {
+      continue;
+    }
+
+    for (size_t c = 0; c < channels; c++) {
+      swap(reals, imags, ((indexes[k] * channels) + c), ((k * channels) + c));
+    }
+  }
+}
+
+// Mixed-radix and cache-blocked plans transform each channel after deinterleave
+static inline void deinterleaved_butterflies(const FFT_PLAN *plan, float *const reals, float *const imags, const size_t number_of_channels, const float sign) {
+  const size_t size = plan->size;
+
+  float *const channel_reals = plan->channel_reals;
+  float *const channel_imags = plan->channel_imags;
+
+  for (size_t c = 0; c < number_of_channels; c++) {
+    for (size_t n = 0; n < size; n++) {
+      channel_reals[n] = reals[(n * number_of_channels) + c];
+      channel_imags[n] = imags[(n * number_of_channels) + c];
+    }
+
+    butterflies(plan, channel_reals, channel_imags, sign);
+
+    for (size_t n = 0; n < size; n++) {
+      reals[(n * number_of_channels) + c] = channel_reals[n];
+      imags[(n * number_of_channels) + c] = channel_imags[n];
+    }
+  }
+}
+
+static inline void batch_butterflies(const FFT_PLAN *plan, float *const reals, float *const imags, const size_t number_of_channels, const BATCH_LAYOUT layout, const float sign) {
+  const size_t size = plan->size;
+
+  if (layout == PLANAR) {
+    for (size_t c = 0; c < number_of_channels; c++) {
+      butterflies(plan, &reals[c * size], &imags[c * size], sign);
+    }
+
+    return;
+  }
+
+  if ((plan->number_of_factors > 0) || (size >= BLOCKED_FFT_MIN_SIZE)) {
+    deinterleaved_butterflies(plan, reals, imags, number_of_channels, sign);
+  } else {
+    interleaved_butterflies(plan, reals, imags, number_of_channels, sign);
+  }
+}
+
+// `reals` and `imags` have `number_of_channels` x N elements (layout is `PLANAR` or `INTERLEAVED`), every channel shares `plan`
+static inline void BATCH_FFT(const FFT_PLAN *plan, float *const reals, float *const imags, const size_t number_of_channels, const BATCH_LAYOUT layout) {
+  batch_butterflies(plan, reals, imags, number_of_channels, layout, -1.0f);
+}
+
+static inline void BATCH_IFFT(const FFT_PLAN *plan, float *const reals, float *const imags, const size_t number_of_channels, const BATCH_LAYOUT layout) {
+  batch_butterflies(plan, reals, imags, number_of_channels, layout, 1.0f);
+
+  scale_elements((plan->size * number_of_channels), (1.0f / plan->size), reals, imags);
+}
+
+static inline void destroy_rfft_plan(RFFT_PLAN *plan) {
+  if (plan == nullptr) {
+    return;
+  }
+
+  destroy_fft_plan(plan->fft_plan);
+
+  free(plan->twiddle_reals);
+  free(plan->twiddle_imags);
+  free(plan);
+}
+
+// Returns `nullptr` if size is odd or N/2-point FFT is not supported (or memory cannot be allocated)
+static inline RFFT_PLAN *create_rfft_plan(const size_t size) {
+  const size_t half_size = size / 2;
+
+  if ((size & 0x00000001) != 0) {
+    return nullptr;
+  }
+
+  FFT_PLAN *fft_plan = create_fft_plan(half_size);
+
+  if (fft_plan == nullptr) {
+    return nullptr;
+  }
+
+  RFFT_PLAN *plan = (RFFT_PLAN *)calloc(1, sizeof(RFFT_PLAN));
+
+  if (plan == nullptr) {
+    destroy_fft_plan(fft_plan);
+    return nullptr;
+  }
+
+  plan->size     = size;
+  plan->fft_plan = fft_plan;
+
+  // W^{k} = cos((2 * PI * k) / N) - j * sin((2 * PI * k) / N) (0 <= k <= N / 4)
+  plan->twiddle_reals = (float *)calloc(half_size / 2 + 1, sizeof(float));
+  plan->twiddle_imags = (float *)calloc(half_size / 2 + 1, sizeof(float));
+
+  if ((plan->twiddle_reals == nullptr) || (plan->twiddle_imags == nullptr)) {
+    destroy_rfft_plan(plan);
+    return nullptr;
+  }
+
+  for (size_t k = 0; k <= (half_size / 2); k++) {
+    plan->twiddle_reals[k] = cosf((2.0f * M_PI * k) / size);
+    plan->twiddle_imags[k] = sinf((2.0f * M_PI * k) / size);
+  }
+
+  return plan;
+}
+
+// Pack even samples into real part and odd samples into imaginary part
+static inline void pack_real_inputs(const size_t half_size, const float *const inputs, float *const reals, float *const imags) {
+  for (size_t n = 0; n < half_size; n++) {
+    reals[n] = inputs[(2 * n) + 0];
+    imags[n] = inputs[(2 * n) + 1];
+  }
+}
+
+static inline void unpack_real_outputs(const size_t half_size, const float *const reals, const float *const imags, float *const outputs) {
+  for (size_t n = 0; n < half_size; n++) {
+    outputs[(2 * n) + 0] = reals[n];
+    outputs[(2 * n) + 1] = imags[n];
+  }
+}
+
+// N/2-point spectrum of packed samples -> N/2 + 1 bins of N-point real FFT
+// (`twiddle_reals` and `twiddle_imags` are cos((2 * PI * k) / N) and sin((2 * PI * k) / N) for 0 <= k <= N/4)
+static inline void split_real_spectrum(const size_t half_size, const float *const twiddle_reals, const float *const twiddle_imags, float *const reals, float *const imags) {
+  const float dc_real = reals[0];
+  const float dc_imag = imags[0];
+
+  reals[0] = dc_real + dc_imag;
+  imags[0] = 0.0f;
+
+  reals[half_size] = dc_real - dc_imag;
+  imags[half_size] = 0.0f;
+
+  // X[k]     = E[k] + W^{k} * O[k]
+  // X[N/2-k] = conj(E[k] - W^{k} * O[k])
+  for (size_t k = 1; k <= (half_size / 2); k++) {
+    const size_t c = half_size - k;
+
+    const float z_real = reals[k];
+    const float z_imag = imags[k];
+    const float c_real = reals[c];
+    const float c_imag = imags[c];
+
+    const float e_real = 0.5f * (z_real + c_real);
+    const float e_imag = 0.5f * (z_imag - c_imag);
+    const float o_real = 0.5f * (z_imag + c_imag);
+    const float o_imag = 0.5f * (c_real - z_real);
+
+    const float w_real = twiddle_reals[k];
+    const float w_imag = twiddle_imags[k];
+
+    const float wo_real = (w_real * o_real) + (w_imag * o_imag);
+    const float wo_imag = (w_real * o_imag) - (w_imag * o_real);
+
+    reals[k] = e_real + wo_real;
+    imags[k] = e_imag + wo_imag;
+
+    reals[c] = e_real - wo_real;
+    imags[c] = wo_imag - e_imag;
+  }
+}
+
+// N/2 + 1 bins of N-point real FFT -> N/2-point spectrum of packed samples (inverse of `split_real_spectrum`)
+static inline void merge_real_spectrum(const size_t half_size, const float *const twiddle_reals, const float *const twiddle_imags, float *const reals, float *const imags) {
+  const float dc_real      = reals[0];
+  const float nyquist_real = reals[half_size];
+
+  reals[0] = 0.5f * (dc_real + nyquist_real);
+  imags[0] = 0.5f * (dc_real - nyquist_real);
+
+  // E[k] = (X[k] + conj(X[N/2-k])) / 2
+  // O[k] = W^{-k} * (X[k] - conj(X[N/2-k])) / 2
+  // Z[k] = E[k] + j * O[k]
+  for (size_t k = 1; k <= (half_size / 2); k++) {
+    const size_t c = half_size - k;
+
+    const float x_real = reals[k];
+    const float x_imag = imags[k];
+    const float c_real = reals[c];
+    const float c_imag = imags[c];
+
+    const float e_real = 0.5f * (x_real + c_real);
+    const float e_imag = 0.5f * (x_imag - c_imag);
+    const float d_real = 0.5f * (x_real - c_real);
+    const float d_imag = 0.5f * (x_imag + c_imag);
+
+    const float w_real = twiddle_reals[k];
+    const float w_imag = twiddle_imags[k];
+
+    const float o_real = (w_real * d_real) - (w_imag * d_imag);
+    const float o_imag = (w_real * d_imag) + (w_imag * d_real);
+
+    reals[k] = e_real - o_imag;
+    imags[k] = e_imag + o_real;
+
+    reals[c] = e_real + o_imag;
+    imags[c] = o_real - e_imag;
+  }
+}
+
+// `inputs` has N samples, `reals` and `imags` have N/2 + 1 bins
+static inline void RFFT(const RFFT_PLAN *plan, const float *const inputs, float *const reals, float *const imags) {
+  const size_t half_size = plan->size / 2;
+
+  pack_real_inputs(half_size, inputs, reals, imags);
+
+  FFT(plan->fft_plan, reals, imags);
+
+  split_real_spectrum(half_size, plan->twiddle_reals, plan->twiddle_imags, reals, imags);
+}
+
+// `reals` and `imags` have N/2 + 1 bins (overwritten), `outputs` has N samples
+static inline void IRFFT(const RFFT_PLAN *plan, float *const reals, float *const imags, float *const outputs) {
+  const size_t half_size = plan->size / 2;
+
+  merge_real_spectrum(half_size, plan->twiddle_reals, plan->twiddle_imags, reals, imags);
+
+  IFFT(plan->fft_plan, reals, imags);
+
+  unpack_real_outputs(half_size, reals, imags, outputs);
+}
+
+// Fixed size FFT (e.g., `dsp::RFFT<128>(inputs, reals, imags)` for render quantum)
+// Twiddle factors and bit-reversal permutation are `constexpr` tables, and every loop bound is constant,
+// so that compiler can fully unroll radix-2^2 passes without plan.
+
+// Taylor series (`cosf` and `sinf` are not `constexpr`)
+static constexpr double constexpr_sin(const double x) {
+  double r = x;
+
+  while (r > M_PI) {
+    r -= 2.0 * M_PI;
+  }
+
+  while (r < -M_PI) {
+    r += 2.0 * M_PI;
+  }
+
+  double term = r;
+  double sum  = r;
+
+  for (int i = 1; i < 16; i++) {
+    term *= (0.0 - (r * r)) / ((2.0 * i) * ((2.0 * i) + 1.0));
+    sum  += term;
+  }
+
+  return sum;
+}
+
+static constexpr double constexpr_cos(const double x) {
+  return constexpr_sin(x + (M_PI / 2.0));
+}
+
+static constexpr int constexpr_log2(const size_t n) {
+  return (n <= 1) ? 0 : (1 + constexpr_log2(n / 2));
+}
+
+// Same layout as `twiddle_reals`, `twiddle_imags` and `indexes` in `FFT_PLAN`
+template <size_t N>
+struct FIXED_FFT_TABLE {
+  float twiddle_reals[N];
+  float twiddle_imags[N];
+  size_t indexes[N];
+
+  constexpr FIXED_FFT_TABLE() : twiddle_reals(), twiddle_imags(), indexes() {
+    for (size_t k = 0; k < N; k++) {
+      twiddle_reals[k] = (float)constexpr_cos((2.0 * M_PI * k) / N);
+      twiddle_imags[k] = (float)constexpr_sin((2.0 * M_PI * k) / N);
+    }
+
+    for (size_t k = 0; k < N; k++) {
+      for (size_t b = 1, r = N / 2; b < N; b <<= 1, r >>= 1) {
+        if (k & b) {
+          indexes[k] |= r;
+        }
+      }
+    }
+  }
+};
+
+template <size_t N>
+struct FIXED_FFT {
+  static_assert((N >= 2) && ((N & (N - 1)) == 0), "Fixed size FFT requires power of two");
+
+  static constexpr FIXED_FFT_TABLE<N> table = FIXED_FFT_TABLE<N>();
+
+  // If log2(N) is odd, the first stage is radix-2
+  static constexpr size_t first_radix4_block_size = (constexpr_log2(N) & 0x00000001) ? (N / 2) : N;
+};
+
+template <size_t N>
+constexpr FIXED_FFT_TABLE<N> FIXED_FFT<N>::table;
+
+template <size_t N>
+constexpr size_t FIXED_FFT<N>::first_radix4_block_size;
+
+// Radix-2^2 passes are expanded from `BLOCK_SIZE` down to 4 at compile time
+template <size_t N, size_t BLOCK_SIZE, bool = (BLOCK_SIZE >= 4)>
+struct FIXED_RADIX4_PASS {
+  static inline void butterflies(float *const reals, float *const imags, const float sign) {
+    const size_t quarter_block_size = BLOCK_SIZE / 4;
+    const size_t stride             = N / BLOCK_SIZE;
+
+    const FIXED_FFT_TABLE<N> &table = FIXED_FFT<N>::table;
+
+    for (size_t i = 0; i < N; i += BLOCK_SIZE) {
+      for (size_t j = 0; j < quarter_block_size; j++) {
+        const size_t w1 = 1 * stride * j;
+        const size_t w2 = 2 * stride * j;
+        const size_t w3 = 3 * stride * j;
+
+        radix4_butterfly(reals, imags, (i + j), quarter_block_size, table.twiddle_reals[w1], (sign * table.twiddle_imags[w1]), table.twiddle_reals[w2], (sign * table.twiddle_imags[w2]), table.twiddle_reals[w3], (sign * table.twiddle_imags[w3]), sign);
+      }
+    }
+
+    FIXED_RADIX4_PASS<N, quarter_block_size>::butterflies(reals, imags, sign);
+  }
+};
+
+template <size_t N, size_t BLOCK_SIZE>
+struct FIXED_RADIX4_PASS<N, BLOCK_SIZE, false> {
+  static inline void butterflies(float *const, float *const, const float) {
+  }
+};
+
+template <size_t N>
+static inline void fixed_butterflies(float *const reals, float *const imags, const float sign) {
+  const FIXED_FFT_TABLE<N> &table = FIXED_FFT<N>::table;
+
+  if (FIXED_FFT<N>::first_radix4_block_size != N) {
+    for (size_t j = 0; j < (N / 2); j++) {
+      radix2_butterfly(reals, imags, j, (N / 2), table.twiddle_reals[j], (sign * table.twiddle_imags[j]));
+    }
+  }
+
+  FIXED_RADIX4_PASS<N, FIXED_FFT<N>::first_radix4_block_size>::butterflies(reals, imags, sign);
+
+  for (size_t k = 0; k < N; k++) {
+    if (table.indexes[k] <= k) {
+      continue;
+    }
+
+    swap(reals, imags, table.indexes[k], k);
+  }
+}
+
+template <size_t N>
+static inline void FFT(float *const reals, float *const imags) {
+  fixed_butterflies<N>(reals, imags, -1.0f);
+}
+
+template <size_t N>
+static inline void IFFT(float *const reals, float *const imags) {
+  fixed_butterflies<N>(reals, imags, 1.0f);
+
+  normalize(N, reals, imags);
+}
+
+// `inputs` has N samples, `reals` and `imags` have N/2 + 1 bins
+template <size_t N>
+static inline void RFFT(const float *const inputs, float *const reals, float *const imags) {
+  const FIXED_FFT_TABLE<N> &table = FIXED_FFT<N>::table;
+
+  pack_real_inputs((N / 2), inputs, reals, imags);
+
+  FFT<N / 2>(reals, imags);
+
+  split_real_spectrum((N / 2), table.twiddle_reals, table.twiddle_imags, reals, imags);
+}
+
+// `reals` and `imags` have N/2 + 1 bins (overwritten), `outputs` has N samples
+template <size_t N>
+static inline void IRFFT(float *const reals, float *const imags, float *const outputs) {
+  const FIXED_FFT_TABLE<N> &table = FIXED_FFT<N>::table;
+
+  merge_real_spectrum((N / 2), table.twiddle_reals, table.twiddle_imags, reals, imags);
+
+  IFFT<N / 2>(reals, imags);
+
+  unpack_real_outputs((N / 2), reals, imags, outputs);
+}
+
+}  // namespace dsp
+
+#endif
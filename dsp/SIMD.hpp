@@ -0,0 +1,340 @@
+#ifndef DSP_SIMD_HPP
+#define DSP_SIMD_HPP
+
+#include <stdlib.h>
+#include <stdint.h>
+
+// Backend is selected at compile time:
+//   wasm  ... `-msimd128` (4 lanes)
+//   x86   ... SSE2 (4 lanes, always available on x86-64), AVX (8 lanes) if `-mavx2` (or `-mavx`)
+// Every kernel is lane independent and uses only correctly rounded operations (add, sub, mul, div and sqrt, no FMA nor estimate instructions),
+// so that native builds produce the same results as wasm (native builds must not contract them, e.g., `-ffp-contract=off`).
+#if defined(__EMSCRIPTEN__) && defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define DSP_SIMD_WASM
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define DSP_SIMD_SSE2
+#endif
+
+#if defined(DSP_SIMD_SSE2) && defined(__AVX__)
+#include <immintrin.h>
+#define DSP_SIMD_AVX
+#endif
+
+#if defined(DSP_SIMD_WASM) || defined(DSP_SIMD_SSE2)
+#define DSP_SIMD
+#endif
+
+namespace dsp {
+
+#ifdef DSP_SIMD
+// 4 x float (loads and stores are unaligned)
+struct F32X4 {
+#ifdef DSP_SIMD_WASM
+  typedef v128_t type;
+#else
+  typedef __m128 type;
+#endif
+
+  static const size_t lanes = 4;
+
+#ifdef DSP_SIMD_WASM
+  static inline type load(const float *const p) {
+    return wasm_v128_load(p);
+  }
+
+  static inline void store(float *const p, const type v) {
+    wasm_v128_store(p, v);
+  }
+
+  static inline type splat(const float x) {
+    return wasm_f32x4_splat(x);
+  }
+
+  static inline type add(const type a, const type b) {
+    return wasm_f32x4_add(a, b);
+  }
+
+  static inline type sub(const type a, const type b) {
+    return wasm_f32x4_sub(a, b);
+  }
+
+  static inline type mul(const type a, const type b) {
+    return wasm_f32x4_mul(a, b);
+  }
+
+  static inline type div(const type a, const type b) {
+    return wasm_f32x4_div(a, b);
+  }
+
+  static inline type abs(const type v) {
+    return wasm_f32x4_abs(v);
+  }
+
+  // (a > b) ? a : b, and (a < b) ? a : b (`b` if either is NaN or both are zero, the same as SSE `maxps` and `minps`).
+  // `wasm_f32x4_max` and `wasm_f32x4_min` propagate NaN and order -0 < +0, so that pseudo-minimum and pseudo-maximum are used with swapped operands
+  static inline type max(const type a, const type b) {
+    return wasm_f32x4_pmax(b, a);
+  }
+
+  static inline type min(const type a, const type b) {
+    return wasm_f32x4_pmin(b, a);
+  }
+
+  static inline type sqrt(const type v) {
+    return wasm_f32x4_sqrt(v);
+  }
+
+  // 1 / sqrt(v) (wasm has no estimate instruction, so that it is exact)
+  static inline type reciprocal_sqrt(const type v) {
+    return wasm_f32x4_div(wasm_f32x4_splat(1.0f), wasm_f32x4_sqrt(v));
+  }
+
+  // All bits of lane are set if `a > b`, otherwise cleared
+  static inline type greater_than(const type a, const type b) {
+    return wasm_f32x4_gt(a, b);
+  }
+
+  // Lanes of `a` where bits of `mask` are set, lanes of `b` where they are cleared (branchless conditional)
+  static inline type select(const type mask, const type a, const type b) {
+    return wasm_v128_bitselect(a, b, mask);
+  }
+
+  // Lanes set in both masks (logical and of comparisons)
+  static inline type bitwise_and(const type a, const type b) {
+    return wasm_v128_and(a, b);
+  }
+
+  // Bit n is set if lane n of `mask` is set (e.g., to iterate lanes that satisfy comparison)
+  static inline int mask_bits(const type mask) {
+    return wasm_i32x4_bitmask(mask);
+  }
+
+  static inline void transpose(type &v0, type &v1, type &v2, type &v3) {
+    type t0 = wasm_i32x4_shuffle(v0, v1, 0, 4, 1, 5);
+    type t1 = wasm_i32x4_shuffle(v0, v1, 2, 6, 3, 7);
+    type t2 = wasm_i32x4_shuffle(v2, v3, 0, 4, 1, 5);
+    type t3 = wasm_i32x4_shuffle(v2, v3, 2, 6, 3, 7);
+
+    v0 = wasm_i32x4_shuffle(t0, t2, 0, 1, 4, 5);
+    v1 = wasm_i32x4_shuffle(t0, t2, 2, 3, 6, 7);
+    v2 = wasm_i32x4_shuffle(t1, t3, 0, 1, 4, 5);
+    v3 = wasm_i32x4_shuffle(t1, t3, 2, 3, 6, 7);
+  }
+#else
+  static inline type load(const float *const p) {
+    return _mm_loadu_ps(p);
+  }
+
+  static inline void store(float *const p, const type v) {
+    _mm_storeu_ps(p, v);
+  }
+
+  static inline type splat(const float x) {
+    return _mm_set1_ps(x);
+  }
+
+  static inline type add(const type a, const type b) {
+    return _mm_add_ps(a, b);
+  }
+
+  static inline type sub(const type a, const type b) {
+    return _mm_sub_ps(a, b);
+  }
+
+  static inline type mul(const type a, const type b) {
+    return _mm_mul_ps(a, b);
+  }
+
+  static inline type div(const type a, const type b) {
+    return _mm_div_ps(a, b);
+  }
+
+  static inline type abs(const type v) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+  }
+
+  // (a > b) ? a : b, and (a < b) ? a : b (`b` if either is NaN or both are zero)
+  static inline type max(const type a, const type b) {
+    return _mm_max_ps(a, b);
+  }
+
+  static inline type min(const type a, const type b) {
+    return _mm_min_ps(a, b);
+  }
+
+  static inline type sqrt(const type v) {
+    return _mm_sqrt_ps(v);
+  }
+
+  // 1 / sqrt(v) (exact, `_mm_rsqrt_ps` estimate differs between CPUs and from wasm)
+  static inline type reciprocal_sqrt(const type v) {
+    return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(v));
+  }
+
+  // All bits of lane are set if `a > b`, otherwise cleared
+  static inline type greater_than(const type a, const type b) {
+    return _mm_cmpgt_ps(a, b);
+  }
+
+  // Lanes of `a` where bits of `mask` are set, lanes of `b` where they are cleared (branchless conditional)
+  static inline type select(const type mask, const type a, const type b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+  }
+
+  // Lanes set in both masks (logical and of comparisons)
+  static inline type bitwise_and(const type a, const type b) {
+    return _mm_and_ps(a, b);
+  }
+
+  // Bit n is set if lane n of `mask` is set (e.g., to iterate lanes that satisfy comparison)
+  static inline int mask_bits(const type mask) {
+    return _mm_movemask_ps(mask);
+  }
+
+  // Same lane order as `wasm_i32x4_shuffle` version
+  static inline void transpose(type &v0, type &v1, type &v2, type &v3) {
+    type t0 = _mm_unpacklo_ps(v0, v1);
+    type t1 = _mm_unpackhi_ps(v0, v1);
+    type t2 = _mm_unpacklo_ps(v2, v3);
+    type t3 = _mm_unpackhi_ps(v2, v3);
+
+    v0 = _mm_movelh_ps(t0, t2);
+    v1 = _mm_movehl_ps(t2, t0);
+    v2 = _mm_movelh_ps(t1, t3);
+    v3 = _mm_movehl_ps(t3, t1);
+  }
+#endif
+};
+#endif
+
+#ifdef DSP_SIMD
+// 4 x uint32 (integer kernels such as random number generators, shift amounts are compile time constants for SSE2)
+struct U32X4 {
+#ifdef DSP_SIMD_WASM
+  typedef v128_t type;
+#else
+  typedef __m128i type;
+#endif
+
+  static const size_t lanes = 4;
+
+#ifdef DSP_SIMD_WASM
+  static inline type load(const uint32_t *const p) {
+    return wasm_v128_load(p);
+  }
+
+  static inline void store(uint32_t *const p, const type v) {
+    wasm_v128_store(p, v);
+  }
+
+  static inline type splat(const uint32_t x) {
+    return wasm_i32x4_splat((int32_t)x);
+  }
+
+  static inline type add(const type a, const type b) {
+    return wasm_i32x4_add(a, b);
+  }
+
+  static inline type bitwise_xor(const type a, const type b) {
+    return wasm_v128_xor(a, b);
+  }
+
+  static inline type bitwise_or(const type a, const type b) {
+    return wasm_v128_or(a, b);
+  }
+
+  template <int N>
+  static inline type shift_left(const type v) {
+    return wasm_i32x4_shl(v, N);
+  }
+
+  template <int N>
+  static inline type shift_right(const type v) {
+    return wasm_u32x4_shr(v, N);
+  }
+
+  // Reinterpret bits as 4 x float
+  static inline F32X4::type as_f32(const type v) {
+    return v;
+  }
+#else
+  static inline type load(const uint32_t *const p) {
+    return _mm_loadu_si128((const __m128i *)p);
+  }
+
+  static inline void store(uint32_t *const p, const type v) {
+    _mm_storeu_si128((__m128i *)p, v);
+  }
+
+  static inline type splat(const uint32_t x) {
+    return _mm_set1_epi32((int)x);
+  }
+
+  static inline type add(const type a, const type b) {
+    return _mm_add_epi32(a, b);
+  }
+
+  static inline type bitwise_xor(const type a, const type b) {
+    return _mm_xor_si128(a, b);
+  }
+
+  static inline type bitwise_or(const type a, const type b) {
+    return _mm_or_si128(a, b);
+  }
+
+  template <int N>
+  static inline type shift_left(const type v) {
+    return _mm_slli_epi32(v, N);
+  }
+
+  template <int N>
+  static inline type shift_right(const type v) {
+    return _mm_srli_epi32(v, N);
+  }
+
+  // Reinterpret bits as 4 x float
+  static inline F32X4::type as_f32(const type v) {
+    return _mm_castsi128_ps(v);
+  }
+#endif
+};
+#endif
+
+#ifdef DSP_SIMD_AVX
+// 8 x float (only for lane independent kernels, so there is no `transpose`)
+struct F32X8 {
+  typedef __m256 type;
+
+  static const size_t lanes = 8;
+
+  static inline type load(const float *const p) {
+    return _mm256_loadu_ps(p);
+  }
+
+  static inline void store(float *const p, const type v) {
+    _mm256_storeu_ps(p, v);
+  }
+
+  static inline type splat(const float x) {
+    return _mm256_set1_ps(x);
+  }
+
+  static inline type add(const type a, const type b) {
+    return _mm256_add_ps(a, b);
+  }
+
+  static inline type sub(const type a, const type b) {
+    return _mm256_sub_ps(a, b);
+  }
+
+  static inline type mul(const type a, const type b) {
+    return _mm256_mul_ps(a, b);
+  }
+};
+#endif
+
+}  // namespace dsp
+
+#endif
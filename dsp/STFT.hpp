@@ -0,0 +1,193 @@
+#ifndef DSP_STFT_HPP
+#define DSP_STFT_HPP
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "window_function.hpp"
+
+namespace dsp {
+
+// Streaming STFT (analysis, per-frame processing, synthesis by overlap-add) of planar multi-channel signal.
+// Input and output of each channel are ring buffers of frame size (they share `position`),
+// so that pushing and pulling samples never shifts buffers, and only a frame is copied per hop.
+// Every `hop_size` samples, the latest `frame_size` samples are multiplied by analysis window and passed to frame processor,
+// and its result is multiplied by synthesis window and accumulated into output ring buffer (output latency is `frame_size` samples).
+// `synthesis_window` is normalized so that the sum of overlapped analysis x synthesis windows is 1 (perfect reconstruction by identity processor).
+typedef struct {
+  size_t frame_size;
+  size_t hop_size;
+  size_t number_of_channels;
+  float *analysis_window;
+  float *synthesis_window;
+  float *input_rings;
+  float *output_rings;
+  float *frame;
+  size_t position;
+  size_t hop_position;
+} STFT;
+
+// Partially created instance (e.g., allocation failure in `create_stft`) is destroyed as well
+static inline void destroy_stft(STFT *stft) {
+  if (stft == nullptr) {
+    return;
+  }
+
+  free(stft->analysis_window);
+  free(stft->synthesis_window);
+  free(stft->input_rings);
+  free(stft->output_rings);
+  free(stft->frame);
+  free(stft);
+}
+
+// Returns `nullptr` if hop size is 0 or greater than frame size (or memory cannot be allocated)
+static inline STFT *create_stft(const size_t frame_size, const size_t hop_size, const size_t number_of_channels, const WINDOW_FUNCTION analysis_window, const WINDOW_FUNCTION synthesis_window) {
+  if ((frame_size == 0) || (hop_size == 0) || (hop_size > frame_size) || (number_of_channels == 0)) {
+    return nullptr;
+  }
+
+  STFT *stft = (STFT *)calloc(1, sizeof(STFT));
+
+  if (stft == nullptr) {
+    return nullptr;
+  }
+
+  stft->frame_size         = frame_size;
+  stft->hop_size           = hop_size;
+  stft->number_of_channels = number_of_channels;
+
+  stft->analysis_window  = (float *)calloc(frame_size, sizeof(float));
+  stft->synthesis_window = (float *)calloc(frame_size, sizeof(float));
+  stft->input_rings      = (float *)calloc(number_of_channels * frame_size, sizeof(float));
+  stft->output_rings     = (float *)calloc(number_of_channels * frame_size, sizeof(float));
+  stft->frame            = (float *)calloc(frame_size, sizeof(float));
+
+  if ((stft->analysis_window == nullptr) || (stft->synthesis_window == nullptr) || (stft->input_rings == nullptr) || (stft->output_rings == nullptr) || (stft->frame == nullptr)) {
+    destroy_stft(stft);
+    return nullptr;
+  }
+
+  window_function(stft->analysis_window, frame_size, analysis_window);
+  window_function(stft->synthesis_window, frame_size, synthesis_window);
+
+  // Output sample n is the sum of frames overlapped at n mod hop size, n mod hop size + hop size, ...
+  for (size_t n = 0; n < hop_size; n++) {
+    float sum = 0.0f;
+
+    for (size_t m = n; m < frame_size; m += hop_size) {
+      sum += stft->analysis_window[m] * stft->synthesis_window[m];
+    }
+
+    if (sum < 1e-6f) {
+      continue;
+    }
+
+    for (size_t m = n; m < frame_size; m += hop_size) {
+      stft->synthesis_window[m] /= sum;
+    }
+  }
+
+  return stft;
+}
+
+// Clear ring buffers (e.g., on seek), windows are kept
+static inline void reset_stft(STFT *stft) {
+  memset(stft->input_rings, 0, stft->number_of_channels * stft->frame_size * sizeof(float));
+  memset(stft->output_rings, 0, stft->number_of_channels * stft->frame_size * sizeof(float));
+
+  stft->position     = 0;
+  stft->hop_position = 0;
+}
+
+// Frame starts at the oldest sample of ring buffer (`position`)
+static inline void stft_analyze(STFT *stft, const float *const ring) {
+  const size_t frame_size = stft->frame_size;
+  const size_t head_size  = frame_size - stft->position;
+
+  const float *const window = stft->analysis_window;
+
+  float *const frame = stft->frame;
+
+  for (size_t n = 0; n < head_size; n++) {
+    frame[n] = ring[stft->position + n] * window[n];
+  }
+
+  for (size_t n = head_size; n < frame_size; n++) {
+    frame[n] = ring[n - head_size] * window[n];
+  }
+}
+
+static inline void stft_synthesize(STFT *stft, float *const ring) {
+  const size_t frame_size = stft->frame_size;
+  const size_t head_size  = frame_size - stft->position;
+
+  const float *const window = stft->synthesis_window;
+  const float *const frame  = stft->frame;
+
+  for (size_t n = 0; n < head_size; n++) {
+    ring[stft->position + n] += frame[n] * window[n];
+  }
+
+  for (size_t n = head_size; n < frame_size; n++) {
+    ring[n - head_size] += frame[n] * window[n];
+  }
+}
+
+// `inputs` and `outputs` are planar (channel 0 (`size` samples), channel 1 (`size` samples), ...), `size` is arbitrary.
+// `process_frame(channel_number, frame)` modifies windowed frame (`frame_size` samples) in place.
+// It is called for every channel (in order of channel number) per hop.
+template <typename FRAME_PROCESSOR>
+static inline void stft_process(STFT *stft, const float *const inputs, float *const outputs, const size_t size, FRAME_PROCESSOR process_frame) {
+  const size_t frame_size = stft->frame_size;
+
+  size_t offset = 0;
+
+  while (offset < size) {
+    // Chunk neither crosses hop boundary nor the end of ring buffers
+    size_t chunk_size = size - offset;
+
+    if (chunk_size > (stft->hop_size - stft->hop_position)) {
+      chunk_size = stft->hop_size - stft->hop_position;
+    }
+
+    if (chunk_size > (frame_size - stft->position)) {
+      chunk_size = frame_size - stft->position;
+    }
+
+    for (size_t c = 0; c < stft->number_of_channels; c++) {
+      float *const input_ring  = stft->input_rings + (c * frame_size) + stft->position;
+      float *const output_ring = stft->output_rings + (c * frame_size) + stft->position;
+
+      memcpy(input_ring, (inputs + (c * size) + offset), chunk_size * sizeof(float));
+      memcpy((outputs + (c * size) + offset), output_ring, chunk_size * sizeof(float));
+      memset(output_ring, 0, chunk_size * sizeof(float));
+    }
+
+    offset             += chunk_size;
+    stft->hop_position += chunk_size;
+    stft->position     += chunk_size;
+
+    if (stft->position == frame_size) {
+      stft->position = 0;
+    }
+
+    if (stft->hop_position < stft->hop_size) {
+      continue;
+    }
+
+    stft->hop_position = 0;
+
+    for (size_t c = 0; c < stft->number_of_channels; c++) {
+      stft_analyze(stft, (stft->input_rings + (c * frame_size)));
+
+      process_frame(c, stft->frame);
+
+      stft_synthesize(stft, (stft->output_rings + (c * frame_size)));
+    }
+  }
+}
+
+}  // namespace dsp
+
+#endif
@@ -0,0 +1,435 @@
+#ifndef DSP_WSOLA_HPP
+#define DSP_WSOLA_HPP
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "FFT.hpp"
+#include "SIMD.hpp"
+
+namespace dsp {
+
+// Search of the best analysis position
+//   WSOLA_SEARCH_QUICK ... direct correlation on every `WSOLA_COARSE_STEP` lags, then on lags around the best one
+//   WSOLA_SEARCH_FFT   ... correlation on every lag by real FFT (exact, suited to large tolerance)
+typedef enum {
+  WSOLA_SEARCH_QUICK,
+  WSOLA_SEARCH_FFT
+} WSOLA_SEARCH;
+
+// Lag step of coarse search (`WSOLA_SEARCH_QUICK`)
+static const size_t WSOLA_COARSE_STEP = 4;
+
+// Range of speed (input samples per output sample)
+static const float WSOLA_MINIMUM_SPEED = 0.25f;
+static const float WSOLA_MAXIMUM_SPEED = 4.0f;
+
+// Streaming time stretch by WSOLA (waveform similarity overlap-add) of planar multi-channel signal.
+// Every `overlap_size` output samples, the next segment is taken around nominal analysis position (advanced by overlap size x speed)
+// within +-`tolerance` samples, so that it is the most similar to the natural continuation of the previous segment,
+// and the continuation is cross-faded into the segment (raised cosine, `fade_ins[n] + fade_outs[n] = 1`).
+// Similarity is normalized cross-correlation of the mix of channels, so that every channel is shifted by the same lag (stereo image is kept).
+// Input of each channel is accumulated in a linear buffer (`capacity` samples), consumed samples are discarded at the end of `wsola_process`.
+typedef struct {
+  size_t overlap_size;
+  size_t tolerance;
+  size_t number_of_channels;
+  size_t block_size;
+  size_t max_output_size;
+  size_t capacity;
+  WSOLA_SEARCH search;
+  float *fade_ins;
+  float *fade_outs;
+  float *input_buffers;
+  float *mix;
+  size_t size;
+  // Nominal analysis position of the next segment, and position of natural continuation of the previous segment (in input buffers)
+  double nominal_position;
+  size_t natural_position;
+  bool first;
+  // FFT search (`search_size` = 2 x tolerance + overlap size, FFT size is power of two at or above it)
+  RFFT_PLAN *rfft_plan;
+  float *segment;
+  float *segment_reals;
+  float *segment_imags;
+  float *template_reals;
+  float *template_imags;
+} WSOLA;
+
+// Partially created instance (e.g., allocation failure in `create_wsola`) is destroyed as well
+static inline void destroy_wsola(WSOLA *wsola) {
+  if (wsola == nullptr) {
+    return;
+  }
+
+  destroy_rfft_plan(wsola->rfft_plan);
+
+  free(wsola->fade_ins);
+  free(wsola->fade_outs);
+  free(wsola->input_buffers);
+  free(wsola->mix);
+  free(wsola->segment);
+  free(wsola->segment_reals);
+  free(wsola->segment_imags);
+  free(wsola->template_reals);
+  free(wsola->template_imags);
+  free(wsola);
+}
+
+// `block_size` is the maximum number of samples per channel that `wsola_process` receives per call.
+// Returns `nullptr` if sizes are 0 (or memory cannot be allocated)
+static inline WSOLA *create_wsola(const size_t overlap_size, const size_t tolerance, const size_t number_of_channels, const size_t block_size, const WSOLA_SEARCH search) {
+  if ((overlap_size == 0) || (number_of_channels == 0) || (block_size == 0)) {
+    return nullptr;
+  }
+
+  WSOLA *wsola = (WSOLA *)calloc(1, sizeof(WSOLA));
+
+  if (wsola == nullptr) {
+    return nullptr;
+  }
+
+  wsola->overlap_size       = overlap_size;
+  wsola->tolerance          = tolerance;
+  wsola->number_of_channels = number_of_channels;
+  wsola->block_size         = block_size;
+  wsola->search             = search;
+
+  // A segment is emitted per overlap size x speed input samples (+ segments of retained input, the natural continuation may lag behind nominal position)
+  wsola->max_output_size = ((size_t)ceilf(block_size / (overlap_size * WSOLA_MINIMUM_SPEED)) + 5) * overlap_size;
+
+  // Retained input is less than 2 x tolerance + overlap size + (overlap size x maximum speed) (see `wsola_process`)
+  wsola->capacity = block_size + (2 * tolerance) + ((2 + (size_t)WSOLA_MAXIMUM_SPEED) * overlap_size);
+
+  wsola->fade_ins      = (float *)calloc(overlap_size, sizeof(float));
+  wsola->fade_outs     = (float *)calloc(overlap_size, sizeof(float));
+  wsola->input_buffers = (float *)calloc(number_of_channels * wsola->capacity, sizeof(float));
+  wsola->mix           = (float *)calloc(wsola->capacity, sizeof(float));
+
+  if ((wsola->fade_ins == nullptr) || (wsola->fade_outs == nullptr) || (wsola->input_buffers == nullptr) || (wsola->mix == nullptr)) {
+    destroy_wsola(wsola);
+    return nullptr;
+  }
+
+  for (size_t n = 0; n < overlap_size; n++) {
+    wsola->fade_ins[n]  = 0.5f - (0.5f * cosf((M_PI * (n + 0.5f)) / overlap_size));
+    wsola->fade_outs[n] = 1.0f - wsola->fade_ins[n];
+  }
+
+  if (search == WSOLA_SEARCH_FFT) {
+    const size_t search_size = (2 * tolerance) + overlap_size;
+
+    size_t fft_size = 2;
+
+    while (fft_size < search_size) {
+      fft_size *= 2;
+    }
+
+    wsola->rfft_plan      = create_rfft_plan(fft_size);
+    wsola->segment        = (float *)calloc(fft_size, sizeof(float));
+    wsola->segment_reals  = (float *)calloc((fft_size / 2) + 1, sizeof(float));
+    wsola->segment_imags  = (float *)calloc((fft_size / 2) + 1, sizeof(float));
+    wsola->template_reals = (float *)calloc((fft_size / 2) + 1, sizeof(float));
+    wsola->template_imags = (float *)calloc((fft_size / 2) + 1, sizeof(float));
+
+    if ((wsola->rfft_plan == nullptr) || (wsola->segment == nullptr) || (wsola->segment_reals == nullptr) || (wsola->segment_imags == nullptr) || (wsola->template_reals == nullptr) || (wsola->template_imags == nullptr)) {
+      destroy_wsola(wsola);
+      return nullptr;
+    }
+  }
+
+  // Tolerance samples of silence precede input, so that the first segment can be searched backward
+  wsola->size             = tolerance;
+  wsola->nominal_position = tolerance;
+  wsola->first            = true;
+
+  return wsola;
+}
+
+// sum(x[n] * y[n]) and sum(y[n] * y[n]) (0 <= n < size).
+// Scalar build accumulates 4 partial sums in the same order as SIMD lanes, so that every backend selects the same lag
+static inline void wsola_dot(const float *const x, const float *const y, const size_t size, float &correlation, float &energy) {
+  float correlations[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  float energies[4]     = {0.0f, 0.0f, 0.0f, 0.0f};
+
+  size_t n = 0;
+
+#ifdef DSP_SIMD
+  F32X4::type c = F32X4::splat(0.0f);
+  F32X4::type e = F32X4::splat(0.0f);
+
+  for (; (n + 4) <= size; n += 4) {
+    const F32X4::type xs = F32X4::load(&x[n]);
+    const F32X4::type ys = F32X4::load(&y[n]);
+
+    c = F32X4::add(c, F32X4::mul(xs, ys));
+    e = F32X4::add(e, F32X4::mul(ys, ys));
+  }
+
+  F32X4::store(correlations, c);
+  F32X4::store(energies, e);
+#else
+  for (; (n + 4) <= size; n += 4) {
+    for (size_t lane = 0; lane < 4; lane++) {
+      correlations[lane] += x[n + lane] * y[n + lane];
+      energies[lane]     += y[n + lane] * y[n + lane];
+    }
+  }
+#endif
+
+  correlation = (correlations[0] + correlations[1]) + (correlations[2] + correlations[3]);
+  energy      = (energies[0] + energies[1]) + (energies[2] + energies[3]);
+
+  for (; n < size; n++) {
+    correlation += x[n] * y[n];
+    energy      += y[n] * y[n];
+  }
+}
+
+// Normalized cross-correlation (correlation / sqrt(energy)) compared without sqrt (sign is kept)
+static inline float wsola_score(const float correlation, const float energy) {
+  return (correlation * fabsf(correlation)) / (energy + 1e-12f);
+}
+
+// Returns the best lag (0 ~ 2 x tolerance) of segments that start at `mix + start` by direct correlation
+static inline size_t wsola_quick_search(const WSOLA *wsola, const float *const natural, const size_t start) {
+  const size_t overlap_size = wsola->overlap_size;
+  const size_t tolerance    = wsola->tolerance;
+  const size_t last_lag     = 2 * tolerance;
+
+  const float *const mix = wsola->mix + start;
+
+  float correlation = 0.0f;
+  float energy      = 0.0f;
+
+  // Ties are resolved to nominal position
+  size_t best_lag = tolerance;
+
+  wsola_dot(natural, (mix + best_lag), overlap_size, correlation, energy);
+
+  float best_score = wsola_score(correlation, energy);
+
+  for (size_t lag = 0; lag <= last_lag; lag += WSOLA_COARSE_STEP) {
+    wsola_dot(natural, (mix + lag), overlap_size, correlation, energy);
+
+    const float score = wsola_score(correlation, energy);
+
+    if (score > best_score) {
+      best_score = score;
+      best_lag   = lag;
+    }
+  }
+
+  const size_t coarse_lag = best_lag;
+
+  const size_t first_lag = (coarse_lag >= (WSOLA_COARSE_STEP - 1)) ? (coarse_lag - (WSOLA_COARSE_STEP - 1)) : 0;
+  const size_t end_lag   = ((coarse_lag + WSOLA_COARSE_STEP) <= last_lag) ? (coarse_lag + WSOLA_COARSE_STEP) : (last_lag + 1);
+
+  for (size_t lag = first_lag; lag < end_lag; lag++) {
+    if (lag == coarse_lag) {
+      continue;
+    }
+
+    wsola_dot(natural, (mix + lag), overlap_size, correlation, energy);
+
+    const float score = wsola_score(correlation, energy);
+
+    if (score > best_score) {
+      best_score = score;
+      best_lag   = lag;
+    }
+  }
+
+  return best_lag;
+}
+
+// Returns the best lag (0 ~ 2 x tolerance) of segments that start at `mix + start` by FFT correlation.
+//   correlation[lag] = IRFFT(RFFT(segment) x conj(RFFT(natural continuation)))[lag]
+// Segment (2 x tolerance + overlap size samples) fits FFT size, so that circular correlation does not wrap on lags in range
+static inline size_t wsola_fft_search(const WSOLA *wsola, const float *const natural, const size_t start) {
+  const size_t overlap_size = wsola->overlap_size;
+  const size_t tolerance    = wsola->tolerance;
+  const size_t last_lag     = 2 * tolerance;
+  const size_t search_size  = last_lag + overlap_size;
+  const size_t fft_size     = wsola->rfft_plan->size;
+  const size_t bin_size     = (fft_size / 2) + 1;
+
+  const float *const mix = wsola->mix + start;
+
+  float *const segment        = wsola->segment;
+  float *const segment_reals  = wsola->segment_reals;
+  float *const segment_imags  = wsola->segment_imags;
+  float *const template_reals = wsola->template_reals;
+  float *const template_imags = wsola->template_imags;
+
+  memcpy(segment, natural, overlap_size * sizeof(float));
+  memset((segment + overlap_size), 0, (fft_size - overlap_size) * sizeof(float));
+
+  RFFT(wsola->rfft_plan, segment, template_reals, template_imags);
+
+  memcpy(segment, mix, search_size * sizeof(float));
+  memset((segment + search_size), 0, (fft_size - search_size) * sizeof(float));
+
+  RFFT(wsola->rfft_plan, segment, segment_reals, segment_imags);
+
+  for (size_t k = 0; k < bin_size; k++) {
+    const float real = (segment_reals[k] * template_reals[k]) + (segment_imags[k] * template_imags[k]);
+    const float imag = (segment_imags[k] * template_reals[k]) - (segment_reals[k] * template_imags[k]);
+
+    segment_reals[k] = real;
+    segment_imags[k] = imag;
+  }
+
+  IRFFT(wsola->rfft_plan, segment_reals, segment_imags, segment);
+
+  // Energies of segments by running sum (double, so that subtraction does not accumulate errors)
+  double energy = 0.0;
+
+  for (size_t n = 0; n < overlap_size; n++) {
+    energy += (double)mix[n] * mix[n];
+  }
+
+  size_t best_lag       = tolerance;
+  float best_score      = -INFINITY;
+  float tolerance_score = 0.0f;
+
+  for (size_t lag = 0; lag <= last_lag; lag++) {
+    const float score = wsola_score(segment[lag], (float)energy);
+
+    if (lag == tolerance) {
+      tolerance_score = score;
+    }
+
+    if (score > best_score) {
+      best_score = score;
+      best_lag   = lag;
+    }
+
+    energy += ((double)mix[lag + overlap_size] * mix[lag + overlap_size]) - ((double)mix[lag] * mix[lag]);
+
+    if (energy < 0.0) {
+      energy = 0.0;
+    }
+  }
+
+  // Ties are resolved to nominal position
+  return (best_score > tolerance_score) ? best_lag : tolerance;
+}
+
+// `inputs` is planar (channel 0 (`size` samples), channel 1 (`size` samples), ...), `size` is block size or less.
+// `outputs` has channel c at `outputs + (c * output_stride)` (`output_stride` >= `max_output_size`).
+// `speed` is input samples per output sample (e.g., 0.5 doubles duration), it is clamped to [`WSOLA_MINIMUM_SPEED`, `WSOLA_MAXIMUM_SPEED`].
+// Returns the number of output samples per channel (multiple of overlap size).
+// Output lags input by about tolerance samples, and the last samples are emitted once 2 x tolerance + 2 x overlap size samples (e.g., silence) follow them.
+static inline size_t wsola_process(WSOLA *wsola, const float *const inputs, const size_t size, float *const outputs, const size_t output_stride, const float speed) {
+  const size_t overlap_size       = wsola->overlap_size;
+  const size_t tolerance          = wsola->tolerance;
+  const size_t number_of_channels = wsola->number_of_channels;
+  const size_t capacity           = wsola->capacity;
+
+  const size_t block_size = (size < wsola->block_size) ? size : wsola->block_size;
+
+  const double hop_size = overlap_size * fminf(fmaxf(speed, WSOLA_MINIMUM_SPEED), WSOLA_MAXIMUM_SPEED);
+
+  const float *const fade_ins  = wsola->fade_ins;
+  const float *const fade_outs = wsola->fade_outs;
+
+  float *const mix = wsola->mix;
+
+  const float mix_scale = 1.0f / number_of_channels;
+
+  for (size_t c = 0; c < number_of_channels; c++) {
+    memcpy((wsola->input_buffers + (c * capacity) + wsola->size), (inputs + (c * block_size)), block_size * sizeof(float));
+  }
+
+  for (size_t n = 0; n < block_size; n++) {
+    float sum = 0.0f;
+
+    for (size_t c = 0; c < number_of_channels; c++) {
+      sum += inputs[(c * block_size) + n];
+    }
+
+    mix[wsola->size + n] = sum * mix_scale;
+  }
+
+  wsola->size += block_size;
+
+  size_t output_size = 0;
+
+  while (true) {
+    const size_t nominal_position = (size_t)wsola->nominal_position;
+    const size_t natural_position = wsola->natural_position;
+
+    if ((nominal_position + tolerance + overlap_size) > wsola->size) {
+      break;
+    }
+
+    if (!wsola->first && ((natural_position + overlap_size) > wsola->size)) {
+      break;
+    }
+
+    const size_t start = nominal_position - tolerance;
+
+    size_t position = nominal_position;
+
+    if (!wsola->first) {
+      const size_t lag = (wsola->search == WSOLA_SEARCH_FFT) ? wsola_fft_search(wsola, (mix + natural_position), start) : wsola_quick_search(wsola, (mix + natural_position), start);
+
+      position = start + lag;
+    }
+
+    for (size_t c = 0; c < number_of_channels; c++) {
+      const float *const input_buffer = wsola->input_buffers + (c * capacity);
+
+      float *const output = outputs + (c * output_stride) + output_size;
+
+      // Nothing precedes the first segment, so that it is copied at full gain (not faded in from silence)
+      if (wsola->first) {
+        memcpy(output, (input_buffer + position), overlap_size * sizeof(float));
+      } else {
+        for (size_t n = 0; n < overlap_size; n++) {
+          output[n] = (input_buffer[natural_position + n] * fade_outs[n]) + (input_buffer[position + n] * fade_ins[n]);
+        }
+      }
+    }
+
+    output_size += overlap_size;
+
+    // Natural continuation of this segment follows it by overlap size
+    wsola->natural_position   = position + overlap_size;
+    wsola->nominal_position  += hop_size;
+    wsola->first              = false;
+  }
+
+  // Discard input before the next natural continuation and the next search range
+  size_t discard_size = (size_t)wsola->nominal_position - tolerance;
+
+  if (wsola->natural_position < discard_size) {
+    discard_size = wsola->natural_position;
+  }
+
+  if (discard_size > wsola->size) {
+    discard_size = wsola->size;
+  }
+
+  const size_t retained_size = wsola->size - discard_size;
+
+  for (size_t c = 0; c < number_of_channels; c++) {
+    float *const input_buffer = wsola->input_buffers + (c * capacity);
+
+    memmove(input_buffer, (input_buffer + discard_size), retained_size * sizeof(float));
+  }
+
+  memmove(mix, (mix + discard_size), retained_size * sizeof(float));
+
+  wsola->size               = retained_size;
+  wsola->nominal_position  -= discard_size;
+  wsola->natural_position  -= discard_size;
+
+  return output_size;
+}
+
+}  // namespace dsp
+
+#endif
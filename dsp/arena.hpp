@@ -0,0 +1,78 @@
+#ifndef DSP_ARENA_HPP
+#define DSP_ARENA_HPP
+
+#include <stdlib.h>
+
+namespace dsp {
+
+// Every buffer is 16 bytes aligned (SIMD loads of 4 floats never straddle the alignment)
+static const size_t ARENA_ALIGNMENT = 16;
+
+// Linear allocator for the buffers of an effect.
+// Effects compute the total size at init and allocate once by `create_arena`,
+// so that processing of render quantum performs no heap operations.
+// Buffers are released all at once by `destroy_arena`.
+typedef struct {
+  unsigned char *memory;
+  size_t capacity;
+  size_t offset;
+} ARENA;
+
+// Bytes that `arena_alloc` consumes for `count` elements of `element_size` bytes
+static inline size_t arena_size(const size_t count, const size_t element_size) {
+  return ((count * element_size) + (ARENA_ALIGNMENT - 1)) & ~(ARENA_ALIGNMENT - 1);
+}
+
+// Returns `nullptr` if memory cannot be allocated
+static inline ARENA *create_arena(const size_t capacity) {
+  ARENA *arena = (ARENA *)calloc(1, sizeof(ARENA));
+
+  if (arena == nullptr) {
+    return nullptr;
+  }
+
+  // calloc of wasm (dlmalloc) and glibc returns 8 bytes aligned memory at least, so that 16 bytes are allocated over
+  arena->memory = (unsigned char *)calloc(capacity + ARENA_ALIGNMENT, 1);
+
+  if (arena->memory == nullptr) {
+    free(arena);
+    return nullptr;
+  }
+
+  arena->capacity = capacity;
+  arena->offset   = (ARENA_ALIGNMENT - ((size_t)arena->memory & (ARENA_ALIGNMENT - 1))) & (ARENA_ALIGNMENT - 1);
+
+  return arena;
+}
+
+static inline void destroy_arena(ARENA *arena) {
+  if (arena == nullptr) {
+    return;
+  }
+
+  free(arena->memory);
+  free(arena);
+}
+
+// Returns zero-initialized buffer, or `nullptr` if it exceeds capacity (given to `create_arena`)
+static inline void *arena_alloc(ARENA *arena, const size_t count, const size_t element_size) {
+  const size_t size = arena_size(count, element_size);
+
+  if ((arena->offset + size) > (arena->capacity + ARENA_ALIGNMENT)) {
+    return nullptr;
+  }
+
+  void *p = arena->memory + arena->offset;
+
+  arena->offset += size;
+
+  return p;
+}
+
+static inline float *arena_alloc_floats(ARENA *arena, const size_t count) {
+  return (float *)arena_alloc(arena, count, sizeof(float));
+}
+
+}  // namespace dsp
+
+#endif
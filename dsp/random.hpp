@@ -0,0 +1,155 @@
+#ifndef DSP_RANDOM_HPP
+#define DSP_RANDOM_HPP
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "SIMD.hpp"
+
+namespace dsp {
+
+// xoshiro128+ generators of 4 independent sequences (one per SIMD lane).
+// State is structure of arrays (`s0[lane]` ~ `s3[lane]`), so that SIMD advances 4 generators (and produces 4 samples) per step.
+// Scalar build advances lanes one by one, so that every backend produces the same samples.
+// One `RANDOM` is one stream (e.g., one channel), its samples are lane 0, 1, 2, 3 of step 0, lane 0, 1, 2, 3 of step 1, ...
+static const size_t RANDOM_LANES = 4;
+
+typedef struct {
+  uint32_t s0[RANDOM_LANES];
+  uint32_t s1[RANDOM_LANES];
+  uint32_t s2[RANDOM_LANES];
+  uint32_t s3[RANDOM_LANES];
+} RANDOM;
+
+// SplitMix32 (expands seed into well-mixed state words)
+static inline uint32_t splitmix32(uint32_t &x) {
+  x += 0x9E3779B9u;
+
+  uint32_t z = x;
+
+  z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+  z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+
+  return z ^ (z >> 16);
+}
+
+// Streams of the same seed (e.g., channels) consume disjoint ranges of SplitMix32 sequence, so that they are independent
+static inline void seed_random(RANDOM *random, const uint32_t seed, const uint32_t stream) {
+  uint32_t x = seed + (stream * (4 * RANDOM_LANES) * 0x9E3779B9u);
+
+  for (size_t lane = 0; lane < RANDOM_LANES; lane++) {
+    random->s0[lane] = splitmix32(x);
+    random->s1[lane] = splitmix32(x);
+    random->s2[lane] = splitmix32(x);
+    random->s3[lane] = splitmix32(x);
+
+    // All-zero state is the only fixed point of xoshiro
+    if ((random->s0[lane] | random->s1[lane] | random->s2[lane] | random->s3[lane]) == 0) {
+      random->s0[lane] = 1;
+    }
+  }
+}
+
+// Upper 23 bits as mantissa of [1, 2), then mapped to [-1, 1) (exact in float)
+static inline float uniform_from_bits(const uint32_t bits) {
+  const uint32_t mantissa = (bits >> 9) | 0x3F800000u;
+
+  float f;
+
+  memcpy(&f, &mantissa, sizeof(float));
+
+  return (f * 2.0f) - 3.0f;
+}
+
+static inline void scalar_random_step(RANDOM *random, float *const outputs) {
+  for (size_t lane = 0; lane < RANDOM_LANES; lane++) {
+    uint32_t s0 = random->s0[lane];
+    uint32_t s1 = random->s1[lane];
+    uint32_t s2 = random->s2[lane];
+    uint32_t s3 = random->s3[lane];
+
+    outputs[lane] = uniform_from_bits(s0 + s3);
+
+    const uint32_t t = s1 << 9;
+
+    s2 ^= s0;
+    s3 ^= s1;
+    s1 ^= s2;
+    s0 ^= s3;
+    s2 ^= t;
+    s3 = (s3 << 11) | (s3 >> 21);
+
+    random->s0[lane] = s0;
+    random->s1[lane] = s1;
+    random->s2[lane] = s2;
+    random->s3[lane] = s3;
+  }
+}
+
+#ifdef DSP_SIMD
+// Returns the number of samples that are written (multiple of 4)
+static inline size_t simd_random_uniform(RANDOM *random, float *const outputs, const size_t size) {
+  U32X4::type s0 = U32X4::load(random->s0);
+  U32X4::type s1 = U32X4::load(random->s1);
+  U32X4::type s2 = U32X4::load(random->s2);
+  U32X4::type s3 = U32X4::load(random->s3);
+
+  const U32X4::type exponent = U32X4::splat(0x3F800000u);
+
+  const F32X4::type two   = F32X4::splat(2.0f);
+  const F32X4::type three = F32X4::splat(3.0f);
+
+  size_t n = 0;
+
+  for (; (n + RANDOM_LANES) <= size; n += RANDOM_LANES) {
+    const U32X4::type bits = U32X4::bitwise_or(U32X4::shift_right<9>(U32X4::add(s0, s3)), exponent);
+
+    F32X4::store(&outputs[n], F32X4::sub(F32X4::mul(U32X4::as_f32(bits), two), three));
+
+    const U32X4::type t = U32X4::shift_left<9>(s1);
+
+    s2 = U32X4::bitwise_xor(s2, s0);
+    s3 = U32X4::bitwise_xor(s3, s1);
+    s1 = U32X4::bitwise_xor(s1, s2);
+    s0 = U32X4::bitwise_xor(s0, s3);
+    s2 = U32X4::bitwise_xor(s2, t);
+    s3 = U32X4::bitwise_or(U32X4::shift_left<11>(s3), U32X4::shift_right<21>(s3));
+  }
+
+  U32X4::store(random->s0, s0);
+  U32X4::store(random->s1, s1);
+  U32X4::store(random->s2, s2);
+  U32X4::store(random->s3, s3);
+
+  return n;
+}
+#endif
+
+// Uniform white noise in [-1, 1). State is kept, so that consecutive calls continue the sequence.
+// If size is not multiple of 4, samples of the last step over size are discarded.
+static inline void random_uniform(RANDOM *random, float *const outputs, const size_t size) {
+  size_t n = 0;
+
+#ifdef DSP_SIMD
+  n = simd_random_uniform(random, outputs, size);
+#endif
+
+  for (; (n + RANDOM_LANES) <= size; n += RANDOM_LANES) {
+    scalar_random_step(random, &outputs[n]);
+  }
+
+  if (n < size) {
+    float tails[RANDOM_LANES];
+
+    scalar_random_step(random, tails);
+
+    for (size_t lane = 0; lane < (size - n); lane++) {
+      outputs[n + lane] = tails[lane];
+    }
+  }
+}
+
+}  // namespace dsp
+
+#endif
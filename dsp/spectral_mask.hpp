@@ -0,0 +1,135 @@
+#ifndef DSP_SPECTRAL_MASK_HPP
+#define DSP_SPECTRAL_MASK_HPP
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "SIMD.hpp"
+
+namespace dsp {
+
+// Spectral effects that change magnitude (and keep phase) multiply every bin by real gain (X'[k] = gain[k] * X[k]).
+// Gains are computed from power (|X[k]|^2 = re^2 + im^2) alone,
+// so that neither `atan2f` nor `cosf` / `sinf` (to rebuild complex value from polar form) is required.
+
+// Lower bound of power in divisions (powers of silence are not divided by 0)
+static const float minimum_spectral_power = 1e-30f;
+
+static inline void spectral_powers(const float *const reals, const float *const imags, float *const powers, const size_t size) {
+  size_t k = 0;
+
+#ifdef DSP_SIMD
+  for (; (k + F32X4::lanes) <= size; k += F32X4::lanes) {
+    const F32X4::type real = F32X4::load(&reals[k]);
+    const F32X4::type imag = F32X4::load(&imags[k]);
+
+    F32X4::store(&powers[k], F32X4::add(F32X4::mul(real, real), F32X4::mul(imag, imag)));
+  }
+#endif
+
+  for (; k < size; k++) {
+    powers[k] = (reals[k] * reals[k]) + (imags[k] * imags[k]);
+  }
+}
+
+static inline void apply_spectral_gains(float *const reals, float *const imags, const float *const gains, const size_t size) {
+  size_t k = 0;
+
+#ifdef DSP_SIMD
+  for (; (k + F32X4::lanes) <= size; k += F32X4::lanes) {
+    const F32X4::type gain = F32X4::load(&gains[k]);
+
+    F32X4::store(&reals[k], F32X4::mul(F32X4::load(&reals[k]), gain));
+    F32X4::store(&imags[k], F32X4::mul(F32X4::load(&imags[k]), gain));
+  }
+#endif
+
+  for (; k < size; k++) {
+    reals[k] *= gains[k];
+    imags[k] *= gains[k];
+  }
+}
+
+// Magnitude subtraction (|X'| = max(|X| - (strength * sqrt(noise power)), 0)) as gain:
+//   gain = max(1 - (strength * sqrt(noise power / power)), 0)
+// sqrt(noise power / power) = noise power / sqrt(noise power * power), so that one reciprocal square root is required per bin
+static inline void subtraction_gains(const float *const powers, const float *const noise_powers, float *const gains, const float strength, const size_t size) {
+  size_t k = 0;
+
+#ifdef DSP_SIMD
+  const F32X4::type zeros     = F32X4::splat(0.0f);
+  const F32X4::type ones      = F32X4::splat(1.0f);
+  const F32X4::type strengths = F32X4::splat(strength);
+  const F32X4::type minimums  = F32X4::splat(minimum_spectral_power);
+
+  for (; (k + F32X4::lanes) <= size; k += F32X4::lanes) {
+    const F32X4::type power       = F32X4::load(&powers[k]);
+    const F32X4::type noise_power = F32X4::load(&noise_powers[k]);
+
+    const F32X4::type ratio = F32X4::mul(noise_power, F32X4::reciprocal_sqrt(F32X4::max(F32X4::mul(noise_power, power), minimums)));
+
+    F32X4::store(&gains[k], F32X4::max(F32X4::sub(ones, F32X4::mul(strengths, ratio)), zeros));
+  }
+#endif
+
+  for (; k < size; k++) {
+    // Same operations as `F32X4::reciprocal_sqrt` (so that every bin is rounded in the same way)
+    const float ratio = noise_powers[k] * (1.0f / sqrtf(fmaxf((noise_powers[k] * powers[k]), minimum_spectral_power)));
+
+    gains[k] = fmaxf((1.0f - (strength * ratio)), 0.0f);
+  }
+}
+
+// Wiener gain with decision-directed a priori SNR (Ephraim and Malah):
+//   a posteriori SNR = power / noise power
+//   a priori SNR     = (smoothing * previous clean power / noise power) + ((1 - smoothing) * max(a posteriori SNR - 1, 0))
+//   gain             = max(a priori SNR / (1 + a priori SNR), minimum gain)
+// `gains` (in) are previous gains, and they are smoothed per bin (gain = (gain smoothing * previous gain) + ((1 - gain smoothing) * gain)).
+// `clean_powers` (in) are previous clean powers (gain^2 * power), they are updated for the next frame.
+static inline void wiener_gains(const float *const powers, const float *const noise_powers, float *const clean_powers, float *const gains, const float smoothing, const float gain_smoothing, const float minimum_gain, const size_t size) {
+  size_t k = 0;
+
+#ifdef DSP_SIMD
+  const F32X4::type zeros           = F32X4::splat(0.0f);
+  const F32X4::type ones            = F32X4::splat(1.0f);
+  const F32X4::type minimums        = F32X4::splat(minimum_spectral_power);
+  const F32X4::type smoothings      = F32X4::splat(smoothing);
+  const F32X4::type rest_smoothings = F32X4::splat(1.0f - smoothing);
+  const F32X4::type gain_smoothings = F32X4::splat(gain_smoothing);
+  const F32X4::type rest_gains      = F32X4::splat(1.0f - gain_smoothing);
+  const F32X4::type minimum_gains   = F32X4::splat(minimum_gain);
+
+  for (; (k + F32X4::lanes) <= size; k += F32X4::lanes) {
+    const F32X4::type power = F32X4::load(&powers[k]);
+
+    const F32X4::type reciprocal_noise_power = F32X4::div(ones, F32X4::max(F32X4::load(&noise_powers[k]), minimums));
+
+    const F32X4::type posteriori = F32X4::mul(power, reciprocal_noise_power);
+    const F32X4::type priori     = F32X4::add(F32X4::mul(smoothings, F32X4::mul(F32X4::load(&clean_powers[k]), reciprocal_noise_power)),
+                                              F32X4::mul(rest_smoothings, F32X4::max(F32X4::sub(posteriori, ones), zeros)));
+
+    const F32X4::type gain = F32X4::max(F32X4::div(priori, F32X4::add(ones, priori)), minimum_gains);
+
+    const F32X4::type smoothed_gain = F32X4::add(F32X4::mul(gain_smoothings, F32X4::load(&gains[k])), F32X4::mul(rest_gains, gain));
+
+    F32X4::store(&gains[k], smoothed_gain);
+    F32X4::store(&clean_powers[k], F32X4::mul(F32X4::mul(smoothed_gain, smoothed_gain), power));
+  }
+#endif
+
+  for (; k < size; k++) {
+    const float reciprocal_noise_power = 1.0f / fmaxf(noise_powers[k], minimum_spectral_power);
+
+    const float posteriori = powers[k] * reciprocal_noise_power;
+    const float priori     = (smoothing * (clean_powers[k] * reciprocal_noise_power)) + ((1.0f - smoothing) * fmaxf((posteriori - 1.0f), 0.0f));
+
+    const float gain = fmaxf((priori / (1.0f + priori)), minimum_gain);
+
+    gains[k]        = (gain_smoothing * gains[k]) + ((1.0f - gain_smoothing) * gain);
+    clean_powers[k] = (gains[k] * gains[k]) * powers[k];
+  }
+}
+
+}  // namespace dsp
+
+#endif
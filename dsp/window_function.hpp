@@ -0,0 +1,53 @@
+#ifndef DSP_WINDOW_FUNCTION_HPP
+#define DSP_WINDOW_FUNCTION_HPP
+
+#include <stdlib.h>
+#include <math.h>
+
+namespace dsp {
+
+typedef enum {
+  RECTANGULAR,
+  HANNING,
+  HAMMING
+} WINDOW_FUNCTION;
+
+static inline void window_function(float *const window, const size_t size, const WINDOW_FUNCTION function) {
+  switch (function) {
+    case HANNING: {
+      for (size_t n = 0; n < size; n++) {
+        if (n & 0x00000001) {
+          window[n] = 0.5 - (0.5 * cosf(((2 * M_PI) * (n + 0.5)) / size));
+        } else {
+          window[n] = 0.5 - (0.5 * cosf(((2 * M_PI) * n) / size));
+        }
+      }
+
+      break;
+    }
+
+    case HAMMING: {
+      for (size_t n = 0; n < size; n++) {
+        if (n & 0x00000001) {
+          window[n] = 0.54 - (0.46 * cosf(((2 * M_PI) * (n + 0.5)) / size));
+        } else {
+          window[n] = 0.54 - (0.46 * cosf(((2 * M_PI) * n) / size));
+        }
+      }
+
+      break;
+    }
+
+    case RECTANGULAR: {
+      for (size_t n = 0; n < size; n++) {
+        window[n] = 1.0f;
+      }
+
+      break;
+    }
+  }
+}
+
+}  // namespace dsp
+
+#endif
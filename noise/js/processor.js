@@ -14,10 +14,15 @@ class NoiseGeneratorProcessor extends AudioWorkletProcessor {
 
     this.lastOut = 0;
 
+    this.vossRows = new Float32Array(15);
+    this.vossSum = 0;
+    this.vossCounter = 0;
+
     this.port.onmessage = (event) => {
       switch (event.data.type) {
         case 'whitenoise':
         case 'pinknoise':
+        case 'vossnoise':
         case 'browniannoise': {
           this.type = event.data.type;
           break;
@@ -68,6 +73,27 @@ class NoiseGeneratorProcessor extends AudioWorkletProcessor {
           break;
         }
 
+        case 'vossnoise': {
+          for (let n = 0; n < bufferSize; n++) {
+            this.vossCounter = (this.vossCounter + 1) >>> 0;
+
+            // Number of trailing zeros of counter (limited to the number of rows, so that counter that wraps around to 0 replaces no row)
+            const bits = this.vossCounter | (1 << this.vossRows.length);
+            const k    = 31 - Math.clz32(bits & -bits);
+
+            if (k < this.vossRows.length) {
+              const value = (2 * Math.random()) - 1;
+
+              this.vossSum += value - this.vossRows[k];
+              this.vossRows[k] = value;
+            }
+
+            output[channelNumber][n] = (this.vossSum + ((2 * Math.random()) - 1)) / (this.vossRows.length + 1);
+          }
+
+          break;
+        }
+
         case 'browniannoise': {
           for (let n = 0; n < bufferSize; n++) {
             const white = (2 * Math.random()) - 1;
@@ -1,101 +1,447 @@
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
+#include "../dsp/arena.hpp"
+#include "../dsp/random.hpp"
+
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
 static const int buffer_size = 128;
 
-static float *outputs = nullptr;
+// Channels are processed in groups of `lanes` (filter state of a group is one SIMD vector per coefficient)
+static const size_t lanes = 4;
 
-static float b0 = 0.0f;
-static float b1 = 0.0f;
-static float b2 = 0.0f;
-static float b3 = 0.0f;
-static float b4 = 0.0f;
-static float b5 = 0.0f;
-static float b6 = 0.0f;
+// Number of Voss-McCartney rows (row k is updated every 2^(k + 1) samples, the lowest octave is sample rate / 2^16)
+static const size_t voss_rows = 15;
 
-static float last_out = 0.0f;
+// Every buffer of an instance is allocated from its `arena` by `noise_create` (generators perform no heap operations).
+// Each channel has its own random stream (`randoms`) and filter states, they are kept across blocks,
+// so that channels are decorrelated and the output never repeats per block.
+// Filter states are structure of arrays over channels padded to multiple of `lanes` (e.g., `b0` of channel c is `pinks[(0 * padded) + c]`),
+// so that 4 channels are filtered by one vector per sample.
+// Padded channels have outputs too, but they are not exposed (outputs are planar, padded channels follow the last channel).
+typedef struct {
+  dsp::ARENA *arena;
+  size_t number_of_channels;
+  size_t padded_number_of_channels;
+  dsp::RANDOM *randoms;
+  float *pinks;
+  float *browns;
+  float *voss_rows;
+  float *voss_sums;
+  uint32_t voss_counter;
+  float *outputs;
+  float *updates;
+} NOISE;
 
-#ifdef __cplusplus
-extern "C" {
+// Fill white noise of every channel (padded channels are silent)
+static void noise_white(NOISE *context, float *const outputs) {
+  const size_t number_of_channels        = context->number_of_channels;
+  const size_t padded_number_of_channels = context->padded_number_of_channels;
+
+  for (size_t c = 0; c < number_of_channels; c++) {
+    dsp::random_uniform(&context->randoms[c], (outputs + (c * buffer_size)), buffer_size);
+  }
+
+  memset((outputs + (number_of_channels * buffer_size)), 0, (padded_number_of_channels - number_of_channels) * buffer_size * sizeof(float));
+}
+
+// Paul Kellet's refined method (7 first order filters), `white` and output are in the same place
+static void noise_pink(NOISE *context, float *const outputs) {
+  const size_t padded_number_of_channels = context->padded_number_of_channels;
+
+  float *const b0s = context->pinks + (0 * padded_number_of_channels);
+  float *const b1s = context->pinks + (1 * padded_number_of_channels);
+  float *const b2s = context->pinks + (2 * padded_number_of_channels);
+  float *const b3s = context->pinks + (3 * padded_number_of_channels);
+  float *const b4s = context->pinks + (4 * padded_number_of_channels);
+  float *const b5s = context->pinks + (5 * padded_number_of_channels);
+  float *const b6s = context->pinks + (6 * padded_number_of_channels);
+
+#ifdef DSP_SIMD
+  typedef dsp::F32X4 V;
+
+  const V::type a0 = V::splat(0.99886f);
+  const V::type a1 = V::splat(0.99332f);
+  const V::type a2 = V::splat(0.96900f);
+  const V::type a3 = V::splat(0.86650f);
+  const V::type a4 = V::splat(0.55000f);
+  const V::type a5 = V::splat(-0.7616f);
+  const V::type g0 = V::splat(0.0555179f);
+  const V::type g1 = V::splat(0.0750759f);
+  const V::type g2 = V::splat(0.1538520f);
+  const V::type g3 = V::splat(0.3104856f);
+  const V::type g4 = V::splat(0.5329522f);
+  const V::type g5 = V::splat(0.0168980f);
+  const V::type g6 = V::splat(0.115926f);
+  const V::type gw = V::splat(0.5362f);
+  const V::type gain = V::splat(0.11f);
+
+  for (size_t c = 0; c < padded_number_of_channels; c += lanes) {
+    V::type b0 = V::load(&b0s[c]);
+    V::type b1 = V::load(&b1s[c]);
+    V::type b2 = V::load(&b2s[c]);
+    V::type b3 = V::load(&b3s[c]);
+    V::type b4 = V::load(&b4s[c]);
+    V::type b5 = V::load(&b5s[c]);
+    V::type b6 = V::load(&b6s[c]);
+
+    float *const channels[lanes] = {
+      outputs + ((c + 0) * buffer_size),
+      outputs + ((c + 1) * buffer_size),
+      outputs + ((c + 2) * buffer_size),
+      outputs + ((c + 3) * buffer_size)
+    };
+
+    for (int n = 0; n < buffer_size; n += lanes) {
+      // Rows are channels, transposed rows are samples n ~ n + 3 (of 4 channels)
+      V::type samples[lanes] = {V::load(&channels[0][n]), V::load(&channels[1][n]), V::load(&channels[2][n]), V::load(&channels[3][n])};
+
+      V::transpose(samples[0], samples[1], samples[2], samples[3]);
+
+      for (size_t m = 0; m < lanes; m++) {
+        const V::type white = samples[m];
+
+        b0 = V::add(V::mul(a0, b0), V::mul(white, g0));
+        b1 = V::add(V::mul(a1, b1), V::mul(white, g1));
+        b2 = V::add(V::mul(a2, b2), V::mul(white, g2));
+        b3 = V::add(V::mul(a3, b3), V::mul(white, g3));
+        b4 = V::add(V::mul(a4, b4), V::mul(white, g4));
+        b5 = V::sub(V::mul(a5, b5), V::mul(white, g5));
+
+        V::type sum = V::add(V::add(V::add(V::add(V::add(V::add(b0, b1), b2), b3), b4), b5), b6);
+
+        samples[m] = V::mul(V::add(sum, V::mul(white, gw)), gain);
+
+        b6 = V::mul(white, g6);
+      }
+
+      V::transpose(samples[0], samples[1], samples[2], samples[3]);
+
+      for (size_t lane = 0; lane < lanes; lane++) {
+        V::store(&channels[lane][n], samples[lane]);
+      }
+    }
+
+    V::store(&b0s[c], b0);
+    V::store(&b1s[c], b1);
+    V::store(&b2s[c], b2);
+    V::store(&b3s[c], b3);
+    V::store(&b4s[c], b4);
+    V::store(&b5s[c], b5);
+    V::store(&b6s[c], b6);
+  }
+#else
+  for (size_t c = 0; c < padded_number_of_channels; c++) {
+    float *const channel = outputs + (c * buffer_size);
+
+    float b0 = b0s[c];
+    float b1 = b1s[c];
+    float b2 = b2s[c];
+    float b3 = b3s[c];
+    float b4 = b4s[c];
+    float b5 = b5s[c];
+    float b6 = b6s[c];
+
+    for (int n = 0; n < buffer_size; n++) {
+      const float white = channel[n];
+
+      b0 = (0.99886f * b0) + (white * 0.0555179f);
+      b1 = (0.99332f * b1) + (white * 0.0750759f);
+      b2 = (0.96900f * b2) + (white * 0.1538520f);
+      b3 = (0.86650f * b3) + (white * 0.3104856f);
+      b4 = (0.55000f * b4) + (white * 0.5329522f);
+      b5 = (-0.7616f * b5) - (white * 0.0168980f);
+
+      channel[n] = ((b0 + b1 + b2 + b3 + b4 + b5 + b6) + (white * 0.5362f)) * 0.11f;
+
+      b6 = white * 0.115926f;
+    }
+
+    b0s[c] = b0;
+    b1s[c] = b1;
+    b2s[c] = b2;
+    b3s[c] = b3;
+    b4s[c] = b4;
+    b5s[c] = b5;
+    b6s[c] = b6;
+  }
 #endif
+}
 
-#ifdef __EMSCRIPTEN__
-EMSCRIPTEN_KEEPALIVE
+// Leaky integrator (division by 1.02 is multiplication by its reciprocal, so that SIMD and scalar results are the same)
+static void noise_brown(NOISE *context, float *const outputs) {
+  const size_t padded_number_of_channels = context->padded_number_of_channels;
+
+  float *const last_outs = context->browns;
+
+#ifdef DSP_SIMD
+  typedef dsp::F32X4 V;
+
+  const V::type g    = V::splat(0.02f);
+  const V::type leak = V::splat(1.0f / 1.02f);
+  const V::type gain = V::splat(3.5f);
+
+  for (size_t c = 0; c < padded_number_of_channels; c += lanes) {
+    V::type last_out = V::load(&last_outs[c]);
+
+    float *const channels[lanes] = {
+      outputs + ((c + 0) * buffer_size),
+      outputs + ((c + 1) * buffer_size),
+      outputs + ((c + 2) * buffer_size),
+      outputs + ((c + 3) * buffer_size)
+    };
+
+    for (int n = 0; n < buffer_size; n += lanes) {
+      V::type samples[lanes] = {V::load(&channels[0][n]), V::load(&channels[1][n]), V::load(&channels[2][n]), V::load(&channels[3][n])};
+
+      V::transpose(samples[0], samples[1], samples[2], samples[3]);
+
+      for (size_t m = 0; m < lanes; m++) {
+        last_out = V::mul(V::add(last_out, V::mul(g, samples[m])), leak);
+
+        samples[m] = V::mul(last_out, gain);
+      }
+
+      V::transpose(samples[0], samples[1], samples[2], samples[3]);
+
+      for (size_t lane = 0; lane < lanes; lane++) {
+        V::store(&channels[lane][n], samples[lane]);
+      }
+    }
+
+    V::store(&last_outs[c], last_out);
+  }
+#else
+  for (size_t c = 0; c < padded_number_of_channels; c++) {
+    float *const channel = outputs + (c * buffer_size);
+
+    float last_out = last_outs[c];
+
+    for (int n = 0; n < buffer_size; n++) {
+      last_out = (last_out + (0.02f * channel[n])) * (1.0f / 1.02f);
+
+      channel[n] = last_out * 3.5f;
+    }
+
+    last_outs[c] = last_out;
+  }
 #endif
-float *whitenoise(const unsigned int time) {
-  if (outputs) {
-    free(outputs);
+}
+
+// Voss-McCartney: the sum of `voss_rows` held random values and white noise, row k is replaced every 2^(k + 1) samples.
+// At most one row is replaced per sample (the number of trailing zeros of sample counter), so that it costs 1 addition and 1 subtraction
+// instead of 7 filters. Row index depends only on the counter, so it is shared by every channel (every lane).
+// `updates` (new row values) and output (white noise as input) are planar.
+static void noise_voss(NOISE *context, float *const outputs, const float *const updates) {
+  const size_t padded_number_of_channels = context->padded_number_of_channels;
+
+  const uint32_t counter = context->voss_counter;
+
+  // Counter wraps around to 0 (ctz of 0 is undefined), bit `voss_rows` limits k to `voss_rows` (no row is replaced)
+  const uint32_t stop = (uint32_t)1 << voss_rows;
+
+  float *const rows = context->voss_rows;
+  float *const sums = context->voss_sums;
+
+  // Sum of (voss_rows + 1) values in [-1, 1)
+  const float scale = 1.0f / (float)(voss_rows + 1);
+
+#ifdef DSP_SIMD
+  typedef dsp::F32X4 V;
+
+  const V::type gain = V::splat(scale);
+
+  for (size_t c = 0; c < padded_number_of_channels; c += lanes) {
+    V::type sum = V::load(&sums[c]);
+
+    float *const channels[lanes] = {
+      outputs + ((c + 0) * buffer_size),
+      outputs + ((c + 1) * buffer_size),
+      outputs + ((c + 2) * buffer_size),
+      outputs + ((c + 3) * buffer_size)
+    };
+
+    const float *const channel_updates[lanes] = {
+      updates + ((c + 0) * buffer_size),
+      updates + ((c + 1) * buffer_size),
+      updates + ((c + 2) * buffer_size),
+      updates + ((c + 3) * buffer_size)
+    };
+
+    for (int n = 0; n < buffer_size; n += lanes) {
+      V::type samples[lanes] = {V::load(&channels[0][n]), V::load(&channels[1][n]), V::load(&channels[2][n]), V::load(&channels[3][n])};
+      V::type values[lanes]  = {V::load(&channel_updates[0][n]), V::load(&channel_updates[1][n]), V::load(&channel_updates[2][n]), V::load(&channel_updates[3][n])};
+
+      V::transpose(samples[0], samples[1], samples[2], samples[3]);
+      V::transpose(values[0], values[1], values[2], values[3]);
+
+      for (size_t m = 0; m < lanes; m++) {
+        const size_t k = (size_t)__builtin_ctz((counter + (uint32_t)(n + m) + 1) | stop);
+
+        if (k < voss_rows) {
+          float *const row = rows + (k * padded_number_of_channels) + c;
+
+          sum = V::add(sum, V::sub(values[m], V::load(row)));
+
+          V::store(row, values[m]);
+        }
+
+        samples[m] = V::mul(V::add(sum, samples[m]), gain);
+      }
+
+      V::transpose(samples[0], samples[1], samples[2], samples[3]);
+
+      for (size_t lane = 0; lane < lanes; lane++) {
+        V::store(&channels[lane][n], samples[lane]);
+      }
+    }
+
+    V::store(&sums[c], sum);
   }
+#else
+  for (size_t c = 0; c < padded_number_of_channels; c++) {
+    float *const channel = outputs + (c * buffer_size);
+
+    const float *const channel_update = updates + (c * buffer_size);
+
+    float sum = sums[c];
+
+    for (int n = 0; n < buffer_size; n++) {
+      const size_t k = (size_t)__builtin_ctz((counter + (uint32_t)n + 1) | stop);
 
-  srand(time);
+      if (k < voss_rows) {
+        float *const row = rows + (k * padded_number_of_channels) + c;
 
-  outputs = (float *)calloc(buffer_size, sizeof(float));
+        sum = sum + (channel_update[n] - *row);
 
-  for (int n = 0; n < buffer_size; n++) {
-    outputs[n] = (float)((2.0f * ((float)rand() / (RAND_MAX + 1.0))) - 1.0f);
+        *row = channel_update[n];
+      }
+
+      channel[n] = (sum + channel[n]) * scale;
+    }
+
+    sums[c] = sum;
   }
+#endif
 
-  return outputs;
+  context->voss_counter = counter + buffer_size;
 }
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns `nullptr` if memory cannot be allocated.
+// Instances of the same `seed` produce the same noise (channel `c` is stream `c` of `seed`).
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *pinknoise(const unsigned int time) {
-  if (outputs) {
-    free(outputs);
-  }
+NOISE *noise_create(const size_t number_of_channels, const unsigned int seed) {
+  const size_t padded_number_of_channels = ((number_of_channels + lanes - 1) / lanes) * lanes;
 
-  srand(time);
+  const size_t capacity = dsp::arena_size(1, sizeof(NOISE))
+                        + dsp::arena_size(number_of_channels, sizeof(dsp::RANDOM))
+                        + dsp::arena_size(7 * padded_number_of_channels, sizeof(float))
+                        + dsp::arena_size(padded_number_of_channels, sizeof(float))
+                        + dsp::arena_size(voss_rows * padded_number_of_channels, sizeof(float))
+                        + dsp::arena_size(padded_number_of_channels, sizeof(float))
+                        + (2 * dsp::arena_size(padded_number_of_channels * buffer_size, sizeof(float)));
 
-  outputs = (float *)calloc(buffer_size, sizeof(float));
+  dsp::ARENA *arena = dsp::create_arena(capacity);
 
-  for (int n = 0; n < buffer_size; n++) {
-    float white = (float)((2.0f * ((float)rand() / (RAND_MAX + 1.0))) - 1.0f);
+  if (arena == nullptr) {
+    return nullptr;
+  }
 
-    b0 = (0.99886f * b0) + (white * 0.0555179f);
-    b1 = (0.99332f * b1) + (white * 0.0750759f);
-    b2 = (0.96900f * b2) + (white * 0.1538520f);
-    b3 = (0.86650f * b3) + (white * 0.3104856f);
-    b4 = (0.55000f * b4) + (white * 0.5329522f);
-    b5 = (-0.7616f * b5) - (white * 0.0168980f);
+  // Filter states are zero-initialized by arena
+  NOISE *context = (NOISE *)dsp::arena_alloc(arena, 1, sizeof(NOISE));
 
-    outputs[n] = b0 + b1 + b2 + b3 + b4 + b5 + b6 + (white * 0.5362f);
-    outputs[n] *= 0.11f;
+  context->arena                     = arena;
+  context->number_of_channels        = number_of_channels;
+  context->padded_number_of_channels = padded_number_of_channels;
+  context->randoms                   = (dsp::RANDOM *)dsp::arena_alloc(arena, number_of_channels, sizeof(dsp::RANDOM));
+  context->pinks                     = dsp::arena_alloc_floats(arena, 7 * padded_number_of_channels);
+  context->browns                    = dsp::arena_alloc_floats(arena, padded_number_of_channels);
+  context->voss_rows                 = dsp::arena_alloc_floats(arena, voss_rows * padded_number_of_channels);
+  context->voss_sums                 = dsp::arena_alloc_floats(arena, padded_number_of_channels);
+  context->outputs                   = dsp::arena_alloc_floats(arena, padded_number_of_channels * buffer_size);
+  context->updates                   = dsp::arena_alloc_floats(arena, padded_number_of_channels * buffer_size);
 
-    b6 = white * 0.115926f;
+  for (size_t c = 0; c < number_of_channels; c++) {
+    dsp::seed_random(&context->randoms[c], seed, (uint32_t)c);
   }
 
-  return outputs;
+  return context;
 }
 
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *browniannoise(const unsigned int time) {
-  if (outputs) {
-    free(outputs);
+void noise_destroy(NOISE *context) {
+  if (context == nullptr) {
+    return;
   }
 
-  srand(time);
+  // Instance itself is in the arena
+  dsp::destroy_arena(context->arena);
+}
 
-  outputs = (float *)calloc(buffer_size, sizeof(float));
+// Planar output region (channel 0 (128 samples), channel 1 (128 samples), ...), its address does not change until `noise_destroy`
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *noise_outputs(const NOISE *context) {
+  return context->outputs;
+}
 
-  for (int n = 0; n < buffer_size; n++) {
-    float white = (float)((2.0f * ((float)rand() / (RAND_MAX + 1.0))) - 1.0f);
+// Returns planar output region
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *whitenoise(NOISE *context) {
+  noise_white(context, context->outputs);
 
-    outputs[n] = (last_out + (0.02f * white)) / 1.02f;
+  return context->outputs;
+}
 
-    last_out = (last_out + (0.02f * white)) / 1.02f;
+// Returns planar output region
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *pinknoise(NOISE *context) {
+  // White noise is generated in place, then filtered
+  noise_white(context, context->outputs);
+  noise_pink(context, context->outputs);
 
-    outputs[n] *= 3.5f;
-  }
+  return context->outputs;
+}
+
+// Pink noise by Voss-McCartney (fewer multiplications than `pinknoise`), returns planar output region
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *vossnoise(NOISE *context) {
+  noise_white(context, context->outputs);
+  noise_white(context, context->updates);
+  noise_voss(context, context->outputs, context->updates);
+
+  return context->outputs;
+}
+
+// Returns planar output region
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *browniannoise(NOISE *context) {
+  // White noise is generated in place, then integrated
+  noise_white(context, context->outputs);
+  noise_brown(context, context->outputs);
 
-  return outputs;
+  return context->outputs;
 }
 
 #ifdef __cplusplus
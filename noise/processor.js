@@ -3,13 +3,19 @@ class NoiseGeneratorProcessor extends AudioWorkletProcessor {
     super();
 
     this.instance = null;
+    this.context = 0;
+    this.numberOfChannels = 0;
     this.type = '';
 
+    // View of planar output region (its offset is fixed during the lifetime of context)
+    this.outputLinearMemory = null;
+
     this.port.onmessage = (event) => {
       if (event.data.bytes instanceof ArrayBuffer) {
         WebAssembly
           .instantiate(event.data.bytes)
           .then(async ({ instance }) => {
+            // Context (random streams, filter states and output region) is created in `bind` (it depends on the number of channels)
             this.instance = instance;
           })
           .catch(console.error);
@@ -17,6 +23,7 @@ class NoiseGeneratorProcessor extends AudioWorkletProcessor {
         switch (event.data.type) {
           case 'whitenoise':
           case 'pinknoise':
+          case 'vossnoise':
           case 'browniannoise': {
             this.type = event.data.type;
             break;
@@ -31,43 +38,50 @@ class NoiseGeneratorProcessor extends AudioWorkletProcessor {
     };
   }
 
-  process(inputs, outputs) {
-    if (this.instance === null) {
-      return true;
-    }
-
-    console.time(`currentFrame ${currentFrame}`);
+  bind(numberOfChannels) {
+    const { exports } = this.instance;
 
-    const output = outputs[0];
+    if (this.numberOfChannels !== numberOfChannels) {
+      exports.noise_destroy(this.context);
 
-    const linearMemory = this.instance.exports.memory.buffer;
+      // Seed differs per context, so that processor nodes produce uncorrelated noise
+      this.context = exports.noise_create(numberOfChannels, (Math.random() * 0xffffffff) >>> 0);
+      this.numberOfChannels = numberOfChannels;
+      this.outputLinearMemory = null;
+    }
 
-    for (let channelNumber = 0; channelNumber < output.length; channelNumber++) {
-      switch (this.type) {
-        case 'whitenoise': {
-          const offsetOutput = this.instance.exports.whitenoise(currentFrame);
+    // Memory cannot be allocated
+    if (this.context === 0) {
+      return;
+    }
 
-          output[channelNumber].set(new Float32Array(linearMemory, offsetOutput, 128));
+    // If linear memory grows, its previous `ArrayBuffer` is detached (and view becomes empty)
+    if ((this.outputLinearMemory === null) || (this.outputLinearMemory.length === 0)) {
+      this.outputLinearMemory = new Float32Array(exports.memory.buffer, exports.noise_outputs(this.context), numberOfChannels * 128);
+    }
+  }
 
-          break;
-        }
+  process(inputs, outputs) {
+    if ((this.instance === null) || (this.type === '')) {
+      return true;
+    }
 
-        case 'pinknoise': {
-          const offsetOutput = this.instance.exports.pinknoise(currentFrame);
+    const output = outputs[0];
 
-          output[channelNumber].set(new Float32Array(linearMemory, offsetOutput, 128));
+    this.bind(output.length);
 
-          break;
-        }
+    // Output is silence if context cannot be created
+    if (this.context === 0) {
+      return true;
+    }
 
-        case 'browniannoise': {
-          const offsetOutput = this.instance.exports.browniannoise(currentFrame);
+    console.time(`currentFrame ${currentFrame}`);
 
-          output[channelNumber].set(new Float32Array(linearMemory, offsetOutput, 128));
+    // Every channel is generated by one call (channels are independent streams)
+    this.instance.exports[this.type](this.context);
 
-          break;
-        }
-      }
+    for (let channelNumber = 0; channelNumber < output.length; channelNumber++) {
+      output[channelNumber].set(this.outputLinearMemory.subarray(channelNumber * 128, (channelNumber + 1) * 128));
     }
 
     console.timeEnd(`currentFrame ${currentFrame}`);
@@ -1,52 +1,304 @@
 #include <stdlib.h>
+#include <math.h>
+
+#include "../dsp/SIMD.hpp"
+#include "../dsp/arena.hpp"
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
-#define absf(f) (f >= 0 ? f : (0 - f))
-
 static const int buffer_size = 128;
 
-static float *inputs  = nullptr;
-static float *outputs = nullptr;
+// Channels are processed in groups of `lanes` (state of a group is one SIMD vector)
+static const size_t lanes = 4;
+
+// Averaging time of RMS detector (seconds)
+static const float rms_time = 0.01f;
+
+// Detector of envelope follower (`NOISEGATE_PEAK` compares |x| with level, `NOISEGATE_RMS` compares mean square with level^2)
+enum {
+  NOISEGATE_PEAK = 0,
+  NOISEGATE_RMS  = 1
+};
+
+// Every buffer of an instance is allocated from its `arena` by `noisegate_create` (`noisegate` performs no heap operations).
+// One module instance serves any number of independent instances (e.g., tracks).
+// States are structure of arrays over channels padded to multiple of `lanes` (e.g., gain of channel c is `gains[c]`),
+// so that 4 channels are processed by one vector per sample without branches (gate is opened and closed by compare and select).
+// Lookahead delay line holds `delay_size` samples per channel (sample d of channel c is `delays[(d * padded) + c]`).
+typedef struct {
+  dsp::ARENA *arena;
+  size_t number_of_channels;
+  size_t padded_number_of_channels;
+  float sample_rate;
+  int detector;
+  float rms_coefficient;
+  float attack_coefficient;
+  float release_coefficient;
+  float hold_size;
+  float *envelopes;
+  float *holds;
+  float *gains;
+  float *delays;
+  size_t delay_size;
+  size_t delay_position;
+  float *inputs;
+  float *outputs;
+} NOISEGATE;
+
+// One pole smoothing coefficient, time constant is `time` seconds (0 is immediate)
+static float noisegate_coefficient(const float time, const float sample_rate) {
+  if (time <= 0.0f) {
+    return 1.0f;
+  }
+
+  return 1.0f - expf(-1.0f / (time * sample_rate));
+}
+
+// Per sample (x is input, lookahead delayed input is output):
+//   envelope = |x| (peak) or envelope + (rms coefficient * (x^2 - envelope)) (RMS)
+//   hold     = (envelope > threshold) ? hold size : max(hold - 1, 0)
+//   gain     = gain + (((hold > 0) ? attack coefficient : release coefficient) * (((hold > 0) ? 1 : 0) - gain))
+template <int DETECTOR>
+static void noisegate_channels(NOISEGATE *context, const float level) {
+  const size_t padded_number_of_channels = context->padded_number_of_channels;
+  const size_t delay_size                = context->delay_size;
+
+  const float threshold = (DETECTOR == NOISEGATE_RMS) ? (level * level) : level;
+
+  const float *const inputs = context->inputs;
+
+  float *const outputs = context->outputs;
+
+  float *const envelopes = context->envelopes;
+  float *const holds     = context->holds;
+  float *const gains     = context->gains;
+  float *const delays    = context->delays;
+
+#ifdef DSP_SIMD
+  typedef dsp::F32X4 V;
+
+  const V::type zeros      = V::splat(0.0f);
+  const V::type ones       = V::splat(1.0f);
+  const V::type thresholds = V::splat(threshold);
+  const V::type hold_sizes = V::splat(context->hold_size);
+  const V::type rms        = V::splat(context->rms_coefficient);
+  const V::type attack     = V::splat(context->attack_coefficient);
+  const V::type release    = V::splat(context->release_coefficient);
+
+  for (size_t c = 0; c < padded_number_of_channels; c += lanes) {
+    V::type envelope = V::load(&envelopes[c]);
+    V::type hold     = V::load(&holds[c]);
+    V::type gain     = V::load(&gains[c]);
+
+    size_t position = context->delay_position;
+
+    const float *const input_channels[lanes] = {
+      inputs + ((c + 0) * buffer_size),
+      inputs + ((c + 1) * buffer_size),
+      inputs + ((c + 2) * buffer_size),
+      inputs + ((c + 3) * buffer_size)
+    };
+
+    float *const output_channels[lanes] = {
+      outputs + ((c + 0) * buffer_size),
+      outputs + ((c + 1) * buffer_size),
+      outputs + ((c + 2) * buffer_size),
+      outputs + ((c + 3) * buffer_size)
+    };
+
+    for (int n = 0; n < buffer_size; n += lanes) {
+      // Rows are channels, transposed rows are samples n ~ n + 3 (of 4 channels)
+      V::type samples[lanes] = {V::load(&input_channels[0][n]), V::load(&input_channels[1][n]), V::load(&input_channels[2][n]), V::load(&input_channels[3][n])};
+
+      V::transpose(samples[0], samples[1], samples[2], samples[3]);
+
+      for (size_t m = 0; m < lanes; m++) {
+        const V::type x = samples[m];
+
+        if (DETECTOR == NOISEGATE_RMS) {
+          envelope = V::add(envelope, V::mul(rms, V::sub(V::mul(x, x), envelope)));
+        } else {
+          envelope = V::abs(x);
+        }
+
+        hold = V::select(V::greater_than(envelope, thresholds), hold_sizes, V::max(V::sub(hold, ones), zeros));
+
+        const V::type opened = V::greater_than(hold, zeros);
+
+        gain = V::add(gain, V::mul(V::select(opened, attack, release), V::sub(V::select(opened, ones, zeros), gain)));
+
+        // Delay line has `delay_size` + 1 slots, so that the slot after the newest one is the oldest one (input itself if there is no lookahead)
+        float *const slot = delays + (position * padded_number_of_channels) + c;
+
+        V::store(slot, x);
+
+        position = (position == delay_size) ? 0 : (position + 1);
+
+        samples[m] = V::mul(V::load(delays + (position * padded_number_of_channels) + c), gain);
+      }
+
+      V::transpose(samples[0], samples[1], samples[2], samples[3]);
+
+      for (size_t lane = 0; lane < lanes; lane++) {
+        V::store(&output_channels[lane][n], samples[lane]);
+      }
+    }
+
+    V::store(&envelopes[c], envelope);
+    V::store(&holds[c], hold);
+    V::store(&gains[c], gain);
+  }
+#else
+  const float hold_size = context->hold_size;
+  const float rms       = context->rms_coefficient;
+  const float attack    = context->attack_coefficient;
+  const float release   = context->release_coefficient;
+
+  for (size_t c = 0; c < padded_number_of_channels; c++) {
+    const float *const input = inputs + (c * buffer_size);
+
+    float *const output = outputs + (c * buffer_size);
+
+    float envelope = envelopes[c];
+    float hold     = holds[c];
+    float gain     = gains[c];
+
+    size_t position = context->delay_position;
+
+    for (int n = 0; n < buffer_size; n++) {
+      const float x = input[n];
+
+      if (DETECTOR == NOISEGATE_RMS) {
+        envelope = envelope + (rms * ((x * x) - envelope));
+      } else {
+        envelope = fabsf(x);
+      }
+
+      hold = (envelope > threshold) ? hold_size : fmaxf((hold - 1.0f), 0.0f);
+
+      const bool opened = hold > 0.0f;
+
+      gain = gain + ((opened ? attack : release) * ((opened ? 1.0f : 0.0f) - gain));
+
+      delays[(position * padded_number_of_channels) + c] = x;
+
+      position = (position == delay_size) ? 0 : (position + 1);
+
+      output[n] = delays[(position * padded_number_of_channels) + c] * gain;
+    }
+
+    envelopes[c] = envelope;
+    holds[c]     = hold;
+    gains[c]     = gain;
+  }
+#endif
+
+  context->delay_position = (context->delay_position + buffer_size) % (delay_size + 1);
+}
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// `lookahead` is the delay of output (seconds), gate opens `lookahead` seconds before onset of input.
+// Returns `nullptr` if memory cannot be allocated
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *noisegate(const float level) {
-  if (outputs) {
-    free(outputs);
-  }
+NOISEGATE *noisegate_create(const size_t number_of_channels, const float sample_rate, const float lookahead) {
+  const size_t padded_number_of_channels = ((number_of_channels + lanes - 1) / lanes) * lanes;
+  const size_t delay_size                = (lookahead > 0.0f) ? (size_t)((lookahead * sample_rate) + 0.5f) : 0;
 
-  outputs = (float *)calloc(buffer_size, sizeof(float));
+  const size_t capacity = dsp::arena_size(1, sizeof(NOISEGATE))
+                        + (3 * dsp::arena_size(padded_number_of_channels, sizeof(float)))
+                        + dsp::arena_size((delay_size + 1) * padded_number_of_channels, sizeof(float))
+                        + (2 * dsp::arena_size(padded_number_of_channels * buffer_size, sizeof(float)));
 
-  for (int n = 0; n < buffer_size; n++) {
-    if (absf(inputs[n]) > level) {
-      outputs[n] = inputs[n];
-    } else {
-      outputs[n] = 0.0f;
-    }
+  dsp::ARENA *arena = dsp::create_arena(capacity);
+
+  if (arena == nullptr) {
+    return nullptr;
   }
 
-  return outputs;
+  // States are zero-initialized by arena (gate is closed)
+  NOISEGATE *context = (NOISEGATE *)dsp::arena_alloc(arena, 1, sizeof(NOISEGATE));
+
+  context->arena                     = arena;
+  context->number_of_channels        = number_of_channels;
+  context->padded_number_of_channels = padded_number_of_channels;
+  context->sample_rate               = sample_rate;
+  context->envelopes                 = dsp::arena_alloc_floats(arena, padded_number_of_channels);
+  context->holds                     = dsp::arena_alloc_floats(arena, padded_number_of_channels);
+  context->gains                     = dsp::arena_alloc_floats(arena, padded_number_of_channels);
+  context->delays                    = dsp::arena_alloc_floats(arena, (delay_size + 1) * padded_number_of_channels);
+  context->delay_size                = delay_size;
+  context->inputs                    = dsp::arena_alloc_floats(arena, padded_number_of_channels * buffer_size);
+  context->outputs                   = dsp::arena_alloc_floats(arena, padded_number_of_channels * buffer_size);
+
+  // Attack 1 msec, hold 50 msec, release 100 msec, peak detector
+  context->detector            = NOISEGATE_PEAK;
+  context->rms_coefficient     = noisegate_coefficient(rms_time, sample_rate);
+  context->attack_coefficient  = noisegate_coefficient(0.001f, sample_rate);
+  context->release_coefficient = noisegate_coefficient(0.1f, sample_rate);
+  context->hold_size           = 0.05f * sample_rate;
+
+  return context;
 }
 
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *alloc_memory_inputs(void) {
-  if (inputs) {
-    free(inputs);
+void noisegate_destroy(NOISEGATE *context) {
+  if (context == nullptr) {
+    return;
   }
 
-  inputs = (float *)calloc(buffer_size, sizeof(float));
+  // Instance itself is in the arena
+  dsp::destroy_arena(context->arena);
+}
+
+// `attack`, `hold` and `release` are seconds, `detector` is `NOISEGATE_PEAK` (0) or `NOISEGATE_RMS` (1).
+// Hold is 1 sample at least, gate is opened while `hold` > 0 (if hold is 0, gate is opened only while envelope exceeds level)
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+void noisegate_configure(NOISEGATE *context, const float attack, const float hold, const float release, const int detector) {
+  context->detector            = (detector == NOISEGATE_RMS) ? NOISEGATE_RMS : NOISEGATE_PEAK;
+  context->attack_coefficient  = noisegate_coefficient(attack, context->sample_rate);
+  context->release_coefficient = noisegate_coefficient(release, context->sample_rate);
+  context->hold_size           = fmaxf((hold * context->sample_rate), 1.0f);
+}
+
+// Planar input region (channel 0 (128 samples), channel 1 (128 samples), ...), its address does not change until `noisegate_destroy`
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *noisegate_inputs(const NOISEGATE *context) {
+  return context->inputs;
+}
+
+// Planar output region (same layout as input region), its address does not change until `noisegate_destroy`
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *noisegate_outputs(const NOISEGATE *context) {
+  return context->outputs;
+}
+
+// Returns planar output region (same layout as input region)
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *noisegate(NOISEGATE *context, const float level) {
+  if (context->detector == NOISEGATE_RMS) {
+    noisegate_channels<NOISEGATE_RMS>(context, level);
+  } else {
+    noisegate_channels<NOISEGATE_PEAK>(context, level);
+  }
 
-  return inputs;
+  return context->outputs;
 }
 
 #ifdef __cplusplus
@@ -4,43 +4,109 @@ class NoiseGateProcessor extends AudioWorkletProcessor {
 
     this.instance = null;
     this.level = 0;
+    this.context = 0;
+    this.numberOfChannels = 0;
+
+    // Attack, hold and release (seconds) and detector (0: peak, 1: RMS)
+    this.parameters = { attack: 0.001, hold: 0.05, release: 0.1, detector: 0 };
+
+    // Views of planar input and output regions (their offsets are fixed during the lifetime of context)
+    this.inputLinearMemory  = null;
+    this.outputLinearMemory = null;
 
     this.port.onmessage = (event) => {
       if (event.data.bytes instanceof ArrayBuffer) {
         WebAssembly
           .instantiate(event.data.bytes)
           .then(async ({ instance }) => {
+            // Context (states, delay line and I/O regions) is created in `bind` (it depends on the number of channels)
             this.instance = instance;
           })
           .catch(console.error);
+      } else if (event.data.parameters) {
+        this.parameters = { ...this.parameters, ...event.data.parameters };
+
+        if (this.context !== 0) {
+          this.configure();
+        }
       } else if ((event.data.level >= 0) && (event.data.level <= 1))  {
         this.level = event.data.level;
       }
     };
   }
 
+  configure() {
+    const { attack, hold, release, detector } = this.parameters;
+
+    this.instance.exports.noisegate_configure(this.context, attack, hold, release, detector);
+  }
+
+  bind(numberOfChannels) {
+    const { exports } = this.instance;
+
+    if (this.numberOfChannels !== numberOfChannels) {
+      exports.noisegate_destroy(this.context);
+
+      // Lookahead is 5 msec (output is delayed, so that gate is opened before onset)
+      this.context = exports.noisegate_create(numberOfChannels, sampleRate, 0.005);
+      this.numberOfChannels = numberOfChannels;
+      this.inputLinearMemory = null;
+
+      // Memory cannot be allocated
+      if (this.context === 0) {
+        return;
+      }
+
+      this.configure();
+    }
+
+    if (this.context === 0) {
+      return;
+    }
+
+    // If linear memory grows, its previous `ArrayBuffer` is detached (and views become empty)
+    if ((this.inputLinearMemory === null) || (this.inputLinearMemory.length === 0)) {
+      const linearMemory = exports.memory.buffer;
+
+      this.inputLinearMemory  = new Float32Array(linearMemory, exports.noisegate_inputs(this.context), numberOfChannels * 128);
+      this.outputLinearMemory = new Float32Array(linearMemory, exports.noisegate_outputs(this.context), numberOfChannels * 128);
+    }
+  }
+
   process(inputs, outputs) {
     if (this.instance === null) {
       return false;
     }
 
-    console.time(`currentFrame ${currentFrame}`);
-
     const input  = inputs[0];
     const output = outputs[0];
 
-    const linearMemory = this.instance.exports.memory.buffer;
+    if (input.length === 0) {
+      return true;
+    }
 
-    for (let channelNumber = 0; channelNumber < input.length; channelNumber++) {
-      const offsetInput = this.instance.exports.alloc_memory_inputs();
+    this.bind(input.length);
 
-      const inputLinearMemory = new Float32Array(linearMemory, offsetInput, 128);
+    // Input passes through (without gate) if context cannot be created
+    if (this.context === 0) {
+      for (let channelNumber = 0; channelNumber < input.length; channelNumber++) {
+        output[channelNumber].set(input[channelNumber]);
+      }
 
-      inputLinearMemory.set(input[channelNumber]);
+      return true;
+    }
 
-      const offsetOutput = this.instance.exports.noisegate(this.level);
+    console.time(`currentFrame ${currentFrame}`);
 
-      output[channelNumber].set(new Float32Array(linearMemory, offsetOutput, 128));
+    for (let channelNumber = 0; channelNumber < input.length; channelNumber++) {
+      this.inputLinearMemory.set(input[channelNumber], channelNumber * 128);
+    }
+
+    // Every channel is processed by one call
+    this.instance.exports.noisegate(this.context, this.level);
+
+    for (let channelNumber = 0; channelNumber < input.length; channelNumber++) {
+      output[channelNumber].set(this.outputLinearMemory.subarray(channelNumber * 128, (channelNumber + 1) * 128));
     }
 
     console.timeEnd(`currentFrame ${currentFrame}`);
@@ -1,237 +1,346 @@
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
+#include "../dsp/FFT.hpp"
+#include "../dsp/STFT.hpp"
+#include "../dsp/spectral_mask.hpp"
+#include "../dsp/arena.hpp"
+
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
-static const int buffer_size = 128;
-
-static float *inputs  = nullptr;
-static float *outputs = nullptr;
+// Render quantum size
+static const int render_quantum_size = 128;
+
+// Smoothing factor of power spectrum for minimum statistics (per frame)
+static const float minimum_smoothing = 0.9f;
+
+// Length of minimum search (seconds), minimum is tracked over the last half ~ whole of it
+static const float minimum_window_time = 1.5f;
+
+// Minimum of smoothed power underestimates mean noise power
+static const float minimum_bias = 1.5f;
+
+// Smoothing factor of decision-directed a priori SNR (per frame)
+static const float wiener_smoothing = 0.98f;
+
+// Smoothing factor of Wiener gains (per frame)
+static const float wiener_gain_smoothing = 0.5f;
+
+// Lower bound of Wiener gains (-20 dB, residual noise is kept so that musical noise is masked)
+static const float wiener_minimum_gain = 0.1f;
+
+// Noise estimator (`NOISESUPPRESSOR_TRACKING` follows minimum of smoothed power spectrum per bin,
+// `NOISESUPPRESSOR_PROFILE` uses mean power spectrum learned while `noisesuppressor_learn` is enabled)
+enum {
+  NOISESUPPRESSOR_TRACKING = 0,
+  NOISESUPPRESSOR_PROFILE  = 1
+};
+
+// Suppression rule (`NOISESUPPRESSOR_SUBTRACTION` subtracts noise magnitude,
+// `NOISESUPPRESSOR_WIENER` applies Wiener gain of decision-directed a priori SNR, it costs divisions and its states per bin)
+enum {
+  NOISESUPPRESSOR_SUBTRACTION = 0,
+  NOISESUPPRESSOR_WIENER      = 1
+};
+
+// Frames are framed and overlap-added by `dsp::STFT` (Hann analysis and synthesis windows), so that host only pushes and pulls 128 samples.
+// Plan, STFT and every buffer of an instance are created by `noisesuppressor_create` (`noisesuppressor` performs no heap operations).
+// One module instance serves any number of independent instances (e.g., tracks).
+// Noise estimates are per channel and per bin (bin k of channel c is `[(c * (N/2 + 1)) + k]`).
+typedef struct {
+  dsp::RFFT_PLAN *rfft_plan;
+  dsp::STFT *stft;
+  dsp::ARENA *arena;
+  size_t fft_size;
+  size_t number_of_channels;
+  int estimator;
+  int rule;
+  int learning;
+  // Frames that are averaged into noise profiles
+  size_t learned_frames;
+  // Frames that seed minimum statistics (until the first frame that has no leading silence of STFT)
+  size_t seed_frames;
+  // Frames from the beginning of current minimum search
+  size_t minimum_frames;
+  size_t minimum_window_size;
+  float *inputs;
+  float *outputs;
+  float *noise_profiles;
+  float *smoothed_powers;
+  float *minimums;
+  float *previous_minimums;
+  // States of Wiener rule (smoothed gains and clean powers of the previous frame)
+  float *wiener_gains;
+  float *clean_powers;
+  // Scratch buffers (N/2 + 1 bins)
+  float *reals;
+  float *imags;
+  float *powers;
+  float *gains;
+  float *noise_powers;
+} NOISESUPPRESSOR;
+
+// Noise power spectrum of channel to `noise_powers` (after updating estimates by power spectrum of current frame in `powers`)
+static void noisesuppressor_estimate(NOISESUPPRESSOR *context, const size_t channel_number) {
+  const size_t buffer_size = (context->fft_size / 2) + 1;
+  const size_t offset      = channel_number * buffer_size;
+
+  const float *powers = context->powers;
+
+  float *noise_profile    = context->noise_profiles + offset;
+  float *smoothed_power   = context->smoothed_powers + offset;
+  float *minimum          = context->minimums + offset;
+  float *previous_minimum = context->previous_minimums + offset;
+
+  if (context->learning) {
+    // Running mean
+    const float weight = 1.0f / (float)(context->learned_frames + 1);
+
+    for (size_t k = 0; k < buffer_size; k++) {
+      noise_profile[k] += weight * (powers[k] - noise_profile[k]);
+    }
+  }
 
-static inline int pow2(int n);
-static inline void swap(float *reals, float *imags, int i, int k);
+  // Minimum is restarted every half window, so that noise estimate follows increase of noise floor within a window
+  const bool restart = context->minimum_frames == 0;
 
-static void FFT(float *reals, float *imags, int size);
-static void IFFT(float *reals, float *imags, int size);
+  // States are seeded by power spectrum of frames until the analysis window is filled by input
+  // (otherwise noise estimate is 0 for the first half window, and the next one starts from underestimated smoothed power)
+  if (context->seed_frames > 0) {
+    for (size_t k = 0; k < buffer_size; k++) {
+      smoothed_power[k]   = powers[k];
+      minimum[k]          = powers[k];
+      previous_minimum[k] = powers[k];
+    }
+  }
 
-#ifdef __cplusplus
-extern "C" {
-#endif
+  for (size_t k = 0; k < buffer_size; k++) {
+    smoothed_power[k] = (minimum_smoothing * smoothed_power[k]) + ((1.0f - minimum_smoothing) * powers[k]);
 
-#ifdef __EMSCRIPTEN__
-EMSCRIPTEN_KEEPALIVE
-#endif
-float *noisesuppressor(const float threshold) {
-  if (outputs) {
-    free(outputs);
+    if (restart) {
+      previous_minimum[k] = minimum[k];
+      minimum[k]          = smoothed_power[k];
+    } else if (smoothed_power[k] < minimum[k]) {
+      minimum[k] = smoothed_power[k];
+    }
   }
 
-  outputs = (float *)calloc(buffer_size, sizeof(float));
+  float *noise_power = context->noise_powers;
 
-  float *input_reals  = (float *)calloc(buffer_size, sizeof(float));
-  float *input_imags  = (float *)calloc(buffer_size, sizeof(float));
-  float *output_reals = (float *)calloc(buffer_size, sizeof(float));
-  float *output_imags = (float *)calloc(buffer_size, sizeof(float));
-
-  float *amplitudes = (float *)calloc(buffer_size, sizeof(float));
-  float *phases     = (float *)calloc(buffer_size, sizeof(float));
+  if (context->estimator == NOISESUPPRESSOR_PROFILE) {
+    memcpy(noise_power, noise_profile, buffer_size * sizeof(float));
+    return;
+  }
 
-  for (int n = 0; n < buffer_size; n++) {
-    input_reals[n] = inputs[n];
-    input_imags[n] = 0.0f;
+  for (size_t k = 0; k < buffer_size; k++) {
+    noise_power[k] = minimum_bias * fminf(minimum[k], previous_minimum[k]);
   }
+}
 
-  FFT(input_reals, input_imags, buffer_size);
+// Suppress noise of windowed frame in place (`strength` is the scale of noise magnitude).
+// Suppression is applied as real gain per bin, so that phase is kept without polar form.
+// Both rules share FFT, power spectrum and noise estimate, Wiener rule adds its gain computation only.
+static void noisesuppressor_frame(NOISESUPPRESSOR *context, const size_t channel_number, float *frame, const float strength) {
+  const dsp::RFFT_PLAN *rfft_plan = context->rfft_plan;
 
-  for (int k = 0; k < buffer_size; k++) {
-    amplitudes[k] = sqrtf((input_reals[k] * input_reals[k]) + (input_imags[k] * input_imags[k]));
+  const size_t buffer_size = (context->fft_size / 2) + 1;
+  const size_t offset      = channel_number * buffer_size;
 
-    if ((input_imags[k] != 0.0f) && (input_reals[k] != 0.0f)) {
-      phases[k] = atan2f(input_imags[k], input_reals[k]);
-    }
-  }
+  float *reals        = context->reals;
+  float *imags        = context->imags;
+  float *powers       = context->powers;
+  float *gains        = context->gains;
+  float *noise_powers = context->noise_powers;
 
-  for (int k = 0; k < buffer_size; k++) {
-    amplitudes[k] -= threshold;
+  dsp::RFFT(rfft_plan, frame, reals, imags);
 
-    if (amplitudes[k] < 0.0f) {
-      amplitudes[k] = 0.0f;
-    }
-  }
+  dsp::spectral_powers(reals, imags, powers, buffer_size);
 
-  for (int k = 0; k < buffer_size; k++) {
-    output_reals[k] = amplitudes[k] * cosf(phases[k]);
-    output_imags[k] = amplitudes[k] * sinf(phases[k]);
-  }
+  noisesuppressor_estimate(context, channel_number);
+
+  if (context->rule == NOISESUPPRESSOR_WIENER) {
+    // Scale of magnitude is squared for power
+    for (size_t k = 0; k < buffer_size; k++) {
+      noise_powers[k] *= strength * strength;
+    }
 
-  IFFT(output_reals, output_imags, buffer_size);
+    gains = context->wiener_gains + offset;
 
-  for (int n = 0; n < buffer_size; n++) {
-    outputs[n] = output_reals[n];
+    dsp::wiener_gains(powers, noise_powers, (context->clean_powers + offset), gains, wiener_smoothing, wiener_gain_smoothing, wiener_minimum_gain, buffer_size);
+  } else {
+    dsp::subtraction_gains(powers, noise_powers, gains, strength, buffer_size);
   }
 
-  free(input_reals);
-  free(input_imags);
-  free(output_reals);
-  free(output_imags);
-  free(amplitudes);
-  free(phases);
+  dsp::apply_spectral_gains(reals, imags, gains, buffer_size);
 
-  return outputs;
+  dsp::IRFFT(rfft_plan, reals, imags, frame);
 }
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *alloc_memory_inputs(void) {
-  if (inputs) {
-    free(inputs);
+void noisesuppressor_destroy(NOISESUPPRESSOR *context) {
+  if (context == nullptr) {
+    return;
   }
 
-  inputs = (float *)calloc(buffer_size, sizeof(float));
+  dsp::destroy_rfft_plan(context->rfft_plan);
+  dsp::destroy_stft(context->stft);
 
-  return inputs;
+  // Instance itself is in the arena
+  dsp::destroy_arena(context->arena);
 }
 
-#ifdef __cplusplus
-}
+// FFT size must be even, and its prime factors must be 2, 3 or 5 (e.g., 480, 960, 1024, 2048).
+// Hop size must be FFT size or less (FFT size / 2 or FFT size / 4 for 50% or 75% overlap).
+// Returns `nullptr` if sizes are not supported (or memory cannot be allocated).
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
 #endif
+NOISESUPPRESSOR *noisesuppressor_create(const size_t fft_size, const size_t hop_size, const size_t number_of_channels, const float sample_rate) {
+  dsp::RFFT_PLAN *rfft_plan = dsp::create_rfft_plan(fft_size);
+  dsp::STFT *stft           = dsp::create_stft(fft_size, hop_size, number_of_channels, dsp::HANNING, dsp::HANNING);
 
-static inline int pow2(int n) {
-  if (n == 0) {
-    return 1;
-  }
+  const size_t buffer_size = (fft_size / 2) + 1;
 
-  return 2 << (n - 1);
-}
+  const size_t capacity = dsp::arena_size(1, sizeof(NOISESUPPRESSOR))
+                        + (2 * dsp::arena_size(number_of_channels * render_quantum_size, sizeof(float)))
+                        + (6 * dsp::arena_size(number_of_channels * buffer_size, sizeof(float)))
+                        + (5 * dsp::arena_size(buffer_size, sizeof(float)));
 
-static inline void swap(float *reals, float *imags, int i, int k) {
-  float tmp_real;
-  float tmp_imag;
+  dsp::ARENA *arena = ((rfft_plan != nullptr) && (stft != nullptr)) ? dsp::create_arena(capacity) : nullptr;
 
-  tmp_real = reals[i];
-  tmp_imag = imags[i];
+  if (arena == nullptr) {
+    dsp::destroy_rfft_plan(rfft_plan);
+    dsp::destroy_stft(stft);
+    return nullptr;
+  }
 
-  reals[i] = reals[k];
-  imags[i] = imags[k];
+  NOISESUPPRESSOR *context = (NOISESUPPRESSOR *)dsp::arena_alloc(arena, 1, sizeof(NOISESUPPRESSOR));
+
+  context->rfft_plan          = rfft_plan;
+  context->stft               = stft;
+  context->arena              = arena;
+  context->fft_size           = fft_size;
+  context->number_of_channels = number_of_channels;
+  context->estimator          = NOISESUPPRESSOR_TRACKING;
+  context->rule               = NOISESUPPRESSOR_SUBTRACTION;
+  context->learning           = 0;
+  context->learned_frames     = 0;
+  context->minimum_frames     = 0;
+  context->seed_frames        = (fft_size + hop_size - 1) / hop_size;
+
+  // Half window (in frames), minimum is restarted at this interval
+  context->minimum_window_size = (size_t)((0.5f * minimum_window_time * sample_rate) / hop_size);
+
+  if (context->minimum_window_size == 0) {
+    context->minimum_window_size = 1;
+  }
 
-  reals[k] = tmp_real;
-  imags[k] = tmp_imag;
-}
+  context->inputs  = dsp::arena_alloc_floats(arena, number_of_channels * render_quantum_size);
+  context->outputs = dsp::arena_alloc_floats(arena, number_of_channels * render_quantum_size);
 
-static void FFT(float *reals, float *imags, int size) {
-  int number_of_stages = (int)log2f((float)size);
-
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      int rest = number_of_stages - stage;
-
-      for (int j = 0; j < pow2(rest); j++) {
-        int n = i * pow2(rest + 1) + j;
-        int m = pow2(rest) + n;
-        int r = j * pow2(stage - 1);
-
-        float a_real = reals[n];
-        float a_imag = imags[n];
-        float b_real = reals[m];
-        float b_imag = imags[m];
-        float c_real = cosf((2.0f * M_PI * r) / size);
-        float c_imag = 0 - sinf((2.0f * M_PI * r) / size);
-
-        if (stage < number_of_stages) {
-          reals[n] = a_real + b_real;
-          imags[n] = a_imag + b_imag;
-          reals[m] = (c_real * (a_real - b_real)) - (c_imag * (a_imag - b_imag));
-          imags[m] = (c_real * (a_imag - b_imag)) + (c_imag * (a_real - b_real));
-        } else {
-          reals[n] = a_real + b_real;
-          imags[n] = a_imag + b_imag;
-          reals[m] = a_real - b_real;
-          imags[m] = a_imag - b_imag;
-        }
-      }
-    }
+  context->noise_profiles    = dsp::arena_alloc_floats(arena, number_of_channels * buffer_size);
+  context->smoothed_powers   = dsp::arena_alloc_floats(arena, number_of_channels * buffer_size);
+  context->minimums          = dsp::arena_alloc_floats(arena, number_of_channels * buffer_size);
+  context->previous_minimums = dsp::arena_alloc_floats(arena, number_of_channels * buffer_size);
+
+  context->wiener_gains = dsp::arena_alloc_floats(arena, number_of_channels * buffer_size);
+  context->clean_powers = dsp::arena_alloc_floats(arena, number_of_channels * buffer_size);
+
+  // Wiener gains start from pass through
+  for (size_t k = 0; k < (number_of_channels * buffer_size); k++) {
+    context->wiener_gains[k] = 1.0f;
   }
 
-  int *index = (int *)calloc(size, sizeof(int));
+  context->reals      = dsp::arena_alloc_floats(arena, buffer_size);
+  context->imags      = dsp::arena_alloc_floats(arena, buffer_size);
+  context->powers     = dsp::arena_alloc_floats(arena, buffer_size);
+  context->gains      = dsp::arena_alloc_floats(arena, buffer_size);
 
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    int rest = number_of_stages - stage;
+  context->noise_powers = dsp::arena_alloc_floats(arena, buffer_size);
 
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      index[pow2(stage - 1) + i] = index[i] + pow2(rest);
-    }
-  }
+  return context;
+}
 
-  for (int k = 0; k < size; k++) {
-    if (index[k] <= k) {
-      continue;
-    }
+// `estimator` is `NOISESUPPRESSOR_TRACKING` (0) or `NOISESUPPRESSOR_PROFILE` (1),
+// `rule` is `NOISESUPPRESSOR_SUBTRACTION` (0) or `NOISESUPPRESSOR_WIENER` (1)
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+void noisesuppressor_configure(NOISESUPPRESSOR *context, const int estimator, const int rule) {
+  context->estimator = (estimator == NOISESUPPRESSOR_PROFILE) ? NOISESUPPRESSOR_PROFILE : NOISESUPPRESSOR_TRACKING;
+  context->rule      = (rule == NOISESUPPRESSOR_WIENER) ? NOISESUPPRESSOR_WIENER : NOISESUPPRESSOR_SUBTRACTION;
+}
+
+// While learning is enabled (e.g., while only noise is captured), noise profiles are averaged from the beginning.
+// Profiles are kept after learning is disabled.
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+void noisesuppressor_learn(NOISESUPPRESSOR *context, const int learning) {
+  if (learning && !context->learning) {
+    const size_t buffer_size = (context->fft_size / 2) + 1;
 
-    swap(reals, imags, index[k], k);
+    memset(context->noise_profiles, 0, context->number_of_channels * buffer_size * sizeof(float));
+
+    context->learned_frames = 0;
   }
 
-  free(index);
+  context->learning = learning ? 1 : 0;
 }
 
-static void IFFT(float *reals, float *imags, int size) {
-  int number_of_stages = (int)log2f((float)size);
-
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      int rest = number_of_stages - stage;
-
-      for (int j = 0; j < pow2(rest); j++) {
-        int n = i * pow2(rest + 1) + j;
-        int m = pow2(rest) + n;
-        int r = j * pow2(stage - 1);
-
-        float a_real = reals[n];
-        float a_imag = imags[n];
-        float b_real = reals[m];
-        float b_imag = imags[m];
-        float c_real = cosf((2.0f * M_PI * r) / size);
-        float c_imag = sinf((2.0f * M_PI * r) / size);
-
-        if (stage < number_of_stages) {
-          reals[n] = a_real + b_real;
-          imags[n] = a_imag + b_imag;
-          reals[m] = (c_real * (a_real - b_real)) - (c_imag * (a_imag - b_imag));
-          imags[m] = (c_real * (a_imag - b_imag)) + (c_imag * (a_real - b_real));
-        } else {
-          reals[n] = a_real + b_real;
-          imags[n] = a_imag + b_imag;
-          reals[m] = a_real - b_real;
-          imags[m] = a_imag - b_imag;
-        }
-      }
-    }
-  }
+// Planar input region (channel 0 (128 samples), channel 1 (128 samples), ...), its address does not change until `noisesuppressor_destroy`
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *noisesuppressor_inputs(const NOISESUPPRESSOR *context) {
+  return context->inputs;
+}
 
-  int *index = (int *)calloc(size, sizeof(int));
+// Planar output region (same layout as input region), its address does not change until `noisesuppressor_destroy`
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *noisesuppressor_outputs(const NOISESUPPRESSOR *context) {
+  return context->outputs;
+}
 
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    int rest = number_of_stages - stage;
+// Pushes 128 samples of every channel, and pulls 128 samples (delayed by FFT size)
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *noisesuppressor(NOISESUPPRESSOR *context, const float strength) {
+  const size_t last_channel_number = context->number_of_channels - 1;
 
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      index[pow2(stage - 1) + i] = index[i] + pow2(rest);
-    }
-  }
+  dsp::stft_process(context->stft, context->inputs, context->outputs, render_quantum_size, [&](const size_t channel_number, float *frame) {
+    noisesuppressor_frame(context, channel_number, frame, strength);
 
-  for (int k = 0; k < size; k++) {
-    if (index[k] <= k) {
-      continue;
-    }
+    // Every channel of a hop shares frame counters
+    if (channel_number == last_channel_number) {
+      if (context->learning) {
+        ++context->learned_frames;
+      }
 
-    swap(reals, imags, index[k], k);
-  }
+      // Minimum search starts after seeding
+      if (context->seed_frames > 0) {
+        --context->seed_frames;
+      } else if (++context->minimum_frames == context->minimum_window_size) {
+        context->minimum_frames = 0;
+      }
+    }
+  });
 
-  for (int k = 0; k < size; k++) {
-    reals[k] /= size;
-    imags[k] /= size;
-  }
+  return context->outputs;
+}
 
-  free(index);
+#ifdef __cplusplus
 }
+#endif
@@ -1,9 +1,27 @@
+// Framing, windowing and overlap-add run in WebAssembly (`dsp::STFT`), so that this processor only pushes and pulls 128 samples
 class NoiseSuppressorProcessor extends AudioWorkletProcessor {
-  constructor() {
-    super();
+  constructor(options) {
+    super(options);
 
     this.instance = null;
-    this.threshold = 0;
+    this.strength = 0;
+
+    // Noise estimator (0: minimum tracking, 1: learned profile), suppression rule (0: magnitude subtraction, 1: Wiener)
+    // and whether noise profile is being learned
+    this.estimator = 0;
+    this.rule = 0;
+    this.learning = false;
+
+    this.fftSize = options.processorOptions?.fftSize ?? 1024;
+    this.hopSize = options.processorOptions?.hopSize ?? (this.fftSize / 4);
+
+    // Context (and its regions in linear memory) is created only when the number of channels changes
+    this.context = 0;
+    this.numberOfChannels = 0;
+
+    // Views of input and output regions (their offsets are fixed during the lifetime of context)
+    this.inputLinearMemory  = null;
+    this.outputLinearMemory = null;
 
     this.port.onmessage = (event) => {
       if (event.data.bytes instanceof ArrayBuffer) {
@@ -13,34 +31,92 @@ class NoiseSuppressorProcessor extends AudioWorkletProcessor {
             this.instance = instance;
           })
           .catch(console.error);
-      } else if ((event.data.threshold >= 0) && (event.data.threshold <= 1))  {
-        this.threshold = event.data.threshold;
+      } else if (typeof event.data.learning === 'boolean') {
+        this.learning = event.data.learning;
+
+        if (this.context !== 0) {
+          this.instance.exports.noisesuppressor_learn(this.context, this.learning);
+        }
+      } else if ((event.data.estimator === 0) || (event.data.estimator === 1)) {
+        this.estimator = event.data.estimator;
+
+        if (this.context !== 0) {
+          this.instance.exports.noisesuppressor_configure(this.context, this.estimator, this.rule);
+        }
+      } else if ((event.data.rule === 0) || (event.data.rule === 1)) {
+        this.rule = event.data.rule;
+
+        if (this.context !== 0) {
+          this.instance.exports.noisesuppressor_configure(this.context, this.estimator, this.rule);
+        }
+      } else if ((event.data.strength >= 0) && (event.data.strength <= 4))  {
+        this.strength = event.data.strength;
       }
     };
   }
 
+  bind(numberOfChannels) {
+    const { exports } = this.instance;
+
+    if (numberOfChannels !== this.numberOfChannels) {
+      exports.noisesuppressor_destroy(this.context);
+
+      this.context = exports.noisesuppressor_create(this.fftSize, this.hopSize, numberOfChannels, sampleRate);
+      this.numberOfChannels = numberOfChannels;
+      this.inputLinearMemory = null;
+
+      // FFT size (or hop size) is not supported
+      if (this.context === 0) {
+        return;
+      }
+
+      exports.noisesuppressor_configure(this.context, this.estimator, this.rule);
+      exports.noisesuppressor_learn(this.context, this.learning);
+    }
+
+    if (this.context === 0) {
+      return;
+    }
+
+    // If linear memory grows, its previous `ArrayBuffer` is detached (and views become empty)
+    if ((this.inputLinearMemory === null) || (this.inputLinearMemory.length === 0)) {
+      const linearMemory = exports.memory.buffer;
+
+      this.inputLinearMemory  = new Float32Array(linearMemory, exports.noisesuppressor_inputs(this.context), (numberOfChannels * 128));
+      this.outputLinearMemory = new Float32Array(linearMemory, exports.noisesuppressor_outputs(this.context), (numberOfChannels * 128));
+    }
+  }
+
   process(inputs, outputs) {
     if (this.instance === null) {
       return false;
     }
 
-    console.time(`currentFrame ${currentFrame}`);
-
     const input  = inputs[0];
     const output = outputs[0];
 
-    const linearMemory = this.instance.exports.memory.buffer;
+    const numberOfChannels = input.length;
+
+    if (numberOfChannels === 0) {
+      return true;
+    }
 
-    for (let channelNumber = 0; channelNumber < input.length; channelNumber++) {
-      const offsetInput = this.instance.exports.alloc_memory_inputs();
+    this.bind(numberOfChannels);
 
-      const inputLinearMemory = new Float32Array(linearMemory, offsetInput, 128);
+    if (this.context === 0) {
+      return true;
+    }
 
-      inputLinearMemory.set(input[channelNumber]);
+    console.time(`currentFrame ${currentFrame}`);
+
+    for (let channelNumber = 0; channelNumber < numberOfChannels; channelNumber++) {
+      this.inputLinearMemory.set(input[channelNumber], (channelNumber * 128));
+    }
 
-      const offsetOutput = this.instance.exports.noisesuppressor(this.threshold);
+    this.instance.exports.noisesuppressor(this.context, this.strength);
 
-      output[channelNumber].set(new Float32Array(linearMemory, offsetOutput, 128));
+    for (let channelNumber = 0; channelNumber < numberOfChannels; channelNumber++) {
+      output[channelNumber].set(this.outputLinearMemory.subarray((channelNumber * 128), ((channelNumber + 1) * 128)));
     }
 
     console.timeEnd(`currentFrame ${currentFrame}`);
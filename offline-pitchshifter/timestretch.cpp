@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include "../dsp/WSOLA.hpp"
+#include "../dsp/arena.hpp"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+// Overlap (cross-fade) size and tolerance of search (seconds), suited to speech
+static const float overlap_time   = 0.01f;
+static const float tolerance_time = 0.005f;
+
+// Time stretch by WSOLA (`dsp::WSOLA`), combined with resampling (e.g., `playbackRate`) it shifts pitch without phase vocoder.
+// Input region holds block size samples per channel, and output region holds `output_size` samples per channel.
+// One module instance serves any number of independent instances (e.g., tracks).
+typedef struct {
+  dsp::WSOLA *wsola;
+  dsp::ARENA *arena;
+  size_t number_of_channels;
+  size_t block_size;
+  size_t output_size;
+  float *inputs;
+  float *outputs;
+} TIMESTRETCH;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+void timestretch_destroy(TIMESTRETCH *context) {
+  if (context == nullptr) {
+    return;
+  }
+
+  dsp::destroy_wsola(context->wsola);
+
+  // Instance itself is in the arena
+  dsp::destroy_arena(context->arena);
+}
+
+// `search` is `WSOLA_SEARCH_QUICK` (0) or `WSOLA_SEARCH_FFT` (1).
+// Returns `nullptr` if sizes are 0 (or memory cannot be allocated)
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+TIMESTRETCH *timestretch_create(const size_t number_of_channels, const float sample_rate, const size_t block_size, const int search) {
+  const size_t overlap_size = (size_t)((overlap_time * sample_rate) + 0.5f);
+  const size_t tolerance    = (size_t)((tolerance_time * sample_rate) + 0.5f);
+
+  dsp::WSOLA *wsola = dsp::create_wsola(overlap_size, tolerance, number_of_channels, block_size, ((search == dsp::WSOLA_SEARCH_FFT) ? dsp::WSOLA_SEARCH_FFT : dsp::WSOLA_SEARCH_QUICK));
+
+  if (wsola == nullptr) {
+    return nullptr;
+  }
+
+  const size_t output_size = wsola->max_output_size;
+
+  const size_t capacity = dsp::arena_size(1, sizeof(TIMESTRETCH))
+                        + dsp::arena_size(number_of_channels * block_size, sizeof(float))
+                        + dsp::arena_size(number_of_channels * output_size, sizeof(float));
+
+  dsp::ARENA *arena = dsp::create_arena(capacity);
+
+  if (arena == nullptr) {
+    dsp::destroy_wsola(wsola);
+    return nullptr;
+  }
+
+  TIMESTRETCH *context = (TIMESTRETCH *)dsp::arena_alloc(arena, 1, sizeof(TIMESTRETCH));
+
+  context->wsola              = wsola;
+  context->arena              = arena;
+  context->number_of_channels = number_of_channels;
+  context->block_size         = block_size;
+  context->output_size        = output_size;
+
+  context->inputs  = dsp::arena_alloc_floats(arena, number_of_channels * block_size);
+  context->outputs = dsp::arena_alloc_floats(arena, number_of_channels * output_size);
+
+  return context;
+}
+
+// Planar input region (channel 0 (block size samples), channel 1 (block size samples), ...), its address does not change until `timestretch_destroy`
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *timestretch_inputs(const TIMESTRETCH *context) {
+  return context->inputs;
+}
+
+// Output region (channel c starts at c x `timestretch_output_size`), its address does not change until `timestretch_destroy`
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *timestretch_outputs(const TIMESTRETCH *context) {
+  return context->outputs;
+}
+
+// Samples per channel of output region (the maximum number of samples that `timestretch` returns)
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+size_t timestretch_output_size(const TIMESTRETCH *context) {
+  return context->output_size;
+}
+
+// Pushes `size` samples (block size or less) of every channel (planar by `size`), and returns the number of samples per channel written to output region.
+// `speed` is input samples per output sample (0.25 ~ 4, e.g., 0.5 doubles duration).
+// Offline rendering passes a whole buffer in blocks, and then 30 msec (2 x (tolerance + overlap)) of silence to flush.
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+size_t timestretch(TIMESTRETCH *context, const size_t size, const float speed) {
+  return dsp::wsola_process(context->wsola, context->inputs, size, context->outputs, context->output_size, speed);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,160 +1,358 @@
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+
+#include "../dsp/FFT.hpp"
+#include "../dsp/SIMD.hpp"
+#include "../dsp/STFT.hpp"
+#include "../dsp/arena.hpp"
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
-static float *inputs  = nullptr;
-static float *outputs = nullptr;
+// Frames are framed and overlap-added by `dsp::STFT` (Hann analysis and synthesis windows), so that host only pushes and pulls blocks of samples.
+// Block size is arbitrary (e.g., 128 for AudioWorklet, or tens of thousands for offline rendering, so that a whole file costs a few calls).
+// Plan, STFT and every buffer of an instance are created by `pitchshifter_create` (`pitchshifter` performs no heap operations).
+// One module instance serves any number of independent instances (e.g., tracks).
+// Shifting bins by d rotates their phases by exp(j 2 pi d t / N) at time t (samples from the beginning of stream).
+// Rotations are phasors of every shift (`phasor_reals[d + N/2]`, `phasor_imags[d + N/2]`, -N/2 <= d <= N/2),
+// they are advanced by `step_reals`, `step_imags` (exp(j 2 pi d x hop size / N)) per hop,
+// so that neither cos nor sin is computed per frame (and phases do not lose precision as t grows).
+typedef struct {
+  dsp::RFFT_PLAN *rfft_plan;
+  dsp::STFT *stft;
+  dsp::ARENA *arena;
+  size_t fft_size;
+  size_t number_of_channels;
+  size_t block_size;
+  float *inputs;
+  float *outputs;
+  float *phasor_reals;
+  float *phasor_imags;
+  float *step_reals;
+  float *step_imags;
+  // Scratch buffers (N/2 + 1 bins)
+  float *reals;
+  float *imags;
+  float *magnitudes;
+  int *peak_indexes;
+  float *shifted_reals;
+  float *shifted_imags;
+  // Regions of influence of the current frame (source bins `region_starts[r]` ~ `region_starts[r] + region_sizes[r] - 1` are shifted by `region_shifts[r]`)
+  int *region_starts;
+  int *region_sizes;
+  int *region_shifts;
+} PITCHSHIFTER;
+
+// Bin k is a peak if its magnitude is greater than magnitudes of k - 2, k - 1, k + 1 and k + 2 (2 <= k < N/2 - 1).
+// Peaks are never closer than 3 bins, so that bins are tested independently (4 bins per comparison mask in SIMD).
+// Returns the number of peaks
+static int pitchshifter_find_peaks(const float *magnitudes, int *peak_indexes, const int size) {
+  const int end = size - 2;
 
-#ifdef __cplusplus
-extern "C" {
-#endif
+  int number_of_peaks = 0;
+  int index           = 2;
 
-#ifdef __EMSCRIPTEN__
-EMSCRIPTEN_KEEPALIVE
+#ifdef DSP_SIMD
+  typedef dsp::F32X4 V;
+
+  for (; (index + (int)V::lanes) <= end; index += V::lanes) {
+    const V::type magnitude = V::load(&magnitudes[index]);
+
+    V::type mask = V::bitwise_and(V::greater_than(magnitude, V::load(&magnitudes[index - 2])), V::greater_than(magnitude, V::load(&magnitudes[index - 1])));
+
+    mask = V::bitwise_and(mask, V::bitwise_and(V::greater_than(magnitude, V::load(&magnitudes[index + 1])), V::greater_than(magnitude, V::load(&magnitudes[index + 2]))));
+
+    // Lowest bit is the lowest bin, so that peaks are in ascending order
+    for (int bits = V::mask_bits(mask); bits != 0; bits &= bits - 1) {
+      peak_indexes[number_of_peaks++] = index + __builtin_ctz(bits);
+    }
+  }
 #endif
-float *pitchshifter(const float pitch, const float speed, const size_t fft_size, const size_t time_cursor) {
-  if (outputs) {
-    free(outputs);
+
+  for (; index < end; index++) {
+    const float magnitude = magnitudes[index];
+
+    if ((magnitude > magnitudes[index - 2]) && (magnitude > magnitudes[index - 1]) && (magnitude > magnitudes[index + 1]) && (magnitude > magnitudes[index + 2])) {
+      peak_indexes[number_of_peaks++] = index;
+    }
   }
 
-  outputs = (float*)calloc(fft_size, sizeof(float));
+  return number_of_peaks;
+}
+
+// shifted bins [0, size) += bins [0, size) x (`phasor_real` + j `phasor_imag`)
+static void pitchshifter_shift_region(const float *reals, const float *imags, float *shifted_reals, float *shifted_imags, const float phasor_real, const float phasor_imag, const int size) {
+  int k = 0;
 
-  float *reals = (float*)calloc(fft_size, sizeof(float));
-  float *imags = (float*)calloc(fft_size, sizeof(float));
+#ifdef DSP_SIMD
+  typedef dsp::F32X4 V;
 
-  float *window = (float*)calloc(fft_size, sizeof(float));
+  const V::type phasor_reals = V::splat(phasor_real);
+  const V::type phasor_imags = V::splat(phasor_imag);
 
-  window_function(window, fft_size, HANNING);
+  for (; (k + (int)V::lanes) <= size; k += V::lanes) {
+    const V::type real = V::load(&reals[k]);
+    const V::type imag = V::load(&imags[k]);
 
-  for (int n = 0; n < fft_size; n++) {
-    reals[n] = window[n] * inputs[n];
-    imags[n] = 0.0f;
+    V::store(&shifted_reals[k], V::add(V::load(&shifted_reals[k]), V::sub(V::mul(real, phasor_reals), V::mul(imag, phasor_imags))));
+    V::store(&shifted_imags[k], V::add(V::load(&shifted_imags[k]), V::add(V::mul(real, phasor_imags), V::mul(imag, phasor_reals))));
   }
+#endif
 
-  FFT(reals, imags, fft_size);
+  for (; k < size; k++) {
+    shifted_reals[k] += (reals[k] * phasor_real) - (imags[k] * phasor_imag);
+    shifted_imags[k] += (reals[k] * phasor_imag) + (imags[k] * phasor_real);
+  }
+}
+
+// Shift peaks (and their regions of influence) of windowed frame in place
+static void pitchshifter_frame(PITCHSHIFTER *context, float *frame, const float pitch, const float speed) {
+  const dsp::RFFT_PLAN *rfft_plan = context->rfft_plan;
+
+  const size_t fft_size = context->fft_size;
+
+  float *reals         = context->reals;
+  float *imags         = context->imags;
+  float *magnitudes    = context->magnitudes;
+  int *peak_indexes    = context->peak_indexes;
+  float *shifted_reals = context->shifted_reals;
+  float *shifted_imags = context->shifted_imags;
+  int *region_starts   = context->region_starts;
+  int *region_sizes    = context->region_sizes;
+  int *region_shifts   = context->region_shifts;
 
   const size_t half_fft_size = fft_size / 2;
   const size_t buffer_size   = half_fft_size + 1;
 
-  float *magnitudes = (float *)calloc(buffer_size, sizeof(float));
-  int *peak_indexes = (int *)calloc(buffer_size, sizeof(int));
+  // Phasor of shift 0
+  const float *phasor_reals = context->phasor_reals + half_fft_size;
+  const float *phasor_imags = context->phasor_imags + half_fft_size;
+
+  dsp::RFFT(rfft_plan, frame, reals, imags);
+
+  // Squared magnitudes (peaks are the same as magnitudes)
+  int k = 0;
+
+#ifdef DSP_SIMD
+  typedef dsp::F32X4 V;
+
+  for (; (k + (int)V::lanes) <= (int)buffer_size; k += V::lanes) {
+    const V::type real = V::load(&reals[k]);
+    const V::type imag = V::load(&imags[k]);
+
+    V::store(&magnitudes[k], V::add(V::mul(real, real), V::mul(imag, imag)));
+  }
+#endif
 
-  for (int k = 0; k < buffer_size; k++) {
+  for (; k < (int)buffer_size; k++) {
     magnitudes[k] = (reals[k] * reals[k]) + (imags[k] * imags[k]);
   }
 
-  int number_of_peaks = 0;
+  const int number_of_peaks = pitchshifter_find_peaks(magnitudes, peak_indexes, buffer_size);
+
+  // Regions of influence tile bins (boundary of adjacent peaks is their midpoint, the first and the last regions extend to DC and Nyquist).
+  // Regions are clipped, so that shifted bins are in [0, N/2] (shifting region loop has no bounds checks)
+  int number_of_regions = 0;
+  int start_index       = 0;
 
-  // Find peaks
-  int index = 2;
+  for (int p = 0; p < number_of_peaks; p++) {
+    const int peak_index = peak_indexes[p];
 
-  const size_t end = half_fft_size + 1 - 2;
+    const int end_index = (p < (number_of_peaks - 1)) ? (peak_index + ((peak_indexes[p + 1] - peak_index + 1) / 2)) : (int)buffer_size;
 
-  while (index < end) {
-    float magnitude = magnitudes[index];
+    const int shifted_peak_index = roundf(peak_index * pitch * (1 / speed));
 
-    if ((magnitudes[index - 1] >= magnitude) || (magnitudes[index - 2] >= magnitude)) {
-      ++index;
-      continue;
+    // Shifted peaks are ascending, so that every peak after this one is also over Nyquist
+    if (shifted_peak_index > (int)buffer_size) {
+      break;
     }
 
-    if ((magnitudes[index + 1] >= magnitude) || (magnitudes[index + 2] >= magnitude)) {
-      ++index;
-      continue;
+    const int shift = shifted_peak_index - peak_index;
+
+    // Region of influence is shifted below DC if pitch < 1 (and over Nyquist if pitch > 1)
+    const int clipped_start_index = (start_index + shift) < 0 ? -shift : start_index;
+    const int clipped_end_index   = (end_index + shift) > (int)buffer_size ? ((int)buffer_size - shift) : end_index;
+
+    if (clipped_start_index < clipped_end_index) {
+      region_starts[number_of_regions] = clipped_start_index;
+      region_sizes[number_of_regions]  = clipped_end_index - clipped_start_index;
+      region_shifts[number_of_regions] = shift;
+
+      ++number_of_regions;
     }
 
-    peak_indexes[number_of_peaks++] = index;
+    start_index = end_index;
+  }
+
+  // Shift regions (regions may overlap after shift if pitch < 1, so that shifted bins are accumulated)
+  memset(shifted_reals, 0, buffer_size * sizeof(float));
+  memset(shifted_imags, 0, buffer_size * sizeof(float));
+
+  for (int r = 0; r < number_of_regions; r++) {
+    const int start = region_starts[r];
+    const int shift = region_shifts[r];
 
-    index += 2;
+    pitchshifter_shift_region((reals + start), (imags + start), (shifted_reals + start + shift), (shifted_imags + start + shift), phasor_reals[shift], phasor_imags[shift], region_sizes[r]);
   }
 
-  // Shift peaks
-  float *shifted_reals = (float*)calloc(fft_size, sizeof(float));
-  float *shifted_imags = (float*)calloc(fft_size, sizeof(float));
+  // Negative frequencies are conjugate symmetric, so IRFFT does not need to mirror them
+  dsp::IRFFT(rfft_plan, shifted_reals, shifted_imags, frame);
+}
 
-  for (int k = 0; k < number_of_peaks; k++) {
-    const int peak_index = peak_indexes[k];
+// Advance phasors of every shift by one hop
+static void pitchshifter_advance(PITCHSHIFTER *context) {
+  const size_t size = context->fft_size + 1;
 
-    const int shifted_peak_index = roundf(peak_index * pitch * (1 / speed));
+  float *phasor_reals = context->phasor_reals;
+  float *phasor_imags = context->phasor_imags;
 
-    if (shifted_peak_index > buffer_size) {
-      break;
-    }
+  const float *step_reals = context->step_reals;
+  const float *step_imags = context->step_imags;
 
-    int start_index = 0;
-    int end_index   = fft_size;
+  for (size_t d = 0; d < size; d++) {
+    const float real = (phasor_reals[d] * step_reals[d]) - (phasor_imags[d] * step_imags[d]);
+    const float imag = (phasor_reals[d] * step_imags[d]) + (phasor_imags[d] * step_reals[d]);
 
-    if (k > 0) {
-      const int peak_index_before = peak_indexes[k - 1];
+    // Magnitude is kept at 1 by a Newton-Raphson step of 1 / sqrt (rounding errors of recurrence do not grow)
+    const float scale = 0.5f * (3.0f - ((real * real) + (imag * imag)));
 
-      start_index = peak_index - floorf((float)(peak_index - peak_index_before) / 2.0f);
-    }
+    phasor_reals[d] = real * scale;
+    phasor_imags[d] = imag * scale;
+  }
+}
 
-    if (k < (number_of_peaks - 1)) {
-      const int peak_index_after = peak_indexes[k + 1];
+#ifdef __cplusplus
+extern "C" {
+#endif
 
-      end_index = peak_index + ceilf((float)(peak_index_after - peak_index) / 2.0f);
-    }
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+void pitchshifter_destroy(PITCHSHIFTER *context) {
+  if (context == nullptr) {
+    return;
+  }
 
-    const int start_offset = start_index - peak_index;
-    const int end_offset   = end_index - peak_index;
+  dsp::destroy_rfft_plan(context->rfft_plan);
+  dsp::destroy_stft(context->stft);
 
-    for (int m = start_offset; m < end_offset; m++) {
-      const int bin_count_index = peak_index + m;
+  // Instance itself is in the arena
+  dsp::destroy_arena(context->arena);
+}
 
-      const int shifted_bin_count_index = shifted_peak_index + m;
+// FFT size must be even, and its prime factors must be 2, 3 or 5 (e.g., 480, 960, 1920, 2048).
+// Hop size must be FFT size or less (e.g., FFT size / 4).
+// Input and output regions hold `block_size` samples per channel (128 for AudioWorklet).
+// Returns `nullptr` if sizes are not supported (or memory cannot be allocated).
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+PITCHSHIFTER *pitchshifter_create(const size_t fft_size, const size_t hop_size, const size_t number_of_channels, const size_t block_size) {
+  dsp::RFFT_PLAN *rfft_plan = dsp::create_rfft_plan(fft_size);
+  dsp::STFT *stft           = dsp::create_stft(fft_size, hop_size, number_of_channels, dsp::HANNING, dsp::HANNING);
 
-      if (shifted_bin_count_index >= buffer_size) {
-        break;
-      }
+  const size_t buffer_size = (fft_size / 2) + 1;
 
-      const float omega = (2.0f * M_PI * (shifted_bin_count_index - bin_count_index)) / fft_size;
+  const size_t capacity = dsp::arena_size(1, sizeof(PITCHSHIFTER))
+                        + (2 * dsp::arena_size(number_of_channels * block_size, sizeof(float)))
+                        + (4 * dsp::arena_size(fft_size + 1, sizeof(float)))
+                        + (5 * dsp::arena_size(buffer_size, sizeof(float)))
+                        + (4 * dsp::arena_size(buffer_size, sizeof(int)));
 
-      const float shifted_real = cosf(omega * time_cursor);
-      const float shifted_imag = sinf(omega * time_cursor);
+  dsp::ARENA *arena = ((rfft_plan != nullptr) && (stft != nullptr) && (block_size > 0)) ? dsp::create_arena(capacity) : nullptr;
 
-      shifted_reals[shifted_bin_count_index] += (reals[bin_count_index] * shifted_real) - (imags[bin_count_index] * shifted_imag);
-      shifted_imags[shifted_bin_count_index] += (reals[bin_count_index] * shifted_imag) + (imags[bin_count_index] * shifted_real);
-    }
+  if (arena == nullptr) {
+    dsp::destroy_rfft_plan(rfft_plan);
+    dsp::destroy_stft(stft);
+    return nullptr;
   }
 
-  free(reals);
-  free(imags);
-  free(magnitudes);
-  free(peak_indexes);
+  PITCHSHIFTER *context = (PITCHSHIFTER *)dsp::arena_alloc(arena, 1, sizeof(PITCHSHIFTER));
 
-  for (int k = 1; k < half_fft_size; k++) {
-    shifted_reals[fft_size - k] = 0.0f + shifted_reals[k];
-    shifted_imags[fft_size - k] = 0.0f - shifted_imags[k];
-  }
+  context->rfft_plan          = rfft_plan;
+  context->stft               = stft;
+  context->arena              = arena;
+  context->fft_size           = fft_size;
+  context->number_of_channels = number_of_channels;
+  context->block_size         = block_size;
 
-  IFFT(shifted_reals, shifted_imags, fft_size);
+  context->inputs  = dsp::arena_alloc_floats(arena, number_of_channels * block_size);
+  context->outputs = dsp::arena_alloc_floats(arena, number_of_channels * block_size);
 
-  for (int n = 0; n < fft_size; n++) {
-    outputs[n] = window[n] * shifted_reals[n];
+  context->phasor_reals = dsp::arena_alloc_floats(arena, fft_size + 1);
+  context->phasor_imags = dsp::arena_alloc_floats(arena, fft_size + 1);
+  context->step_reals   = dsp::arena_alloc_floats(arena, fft_size + 1);
+  context->step_imags   = dsp::arena_alloc_floats(arena, fft_size + 1);
+
+  // Phases start from 0 (t = 0), steps are computed once (in double, so that they are accurate to float)
+  for (size_t n = 0; n <= fft_size; n++) {
+    const double omega = (2.0 * M_PI * (((double)n - (double)(fft_size / 2)) * (double)hop_size)) / (double)fft_size;
+
+    context->phasor_reals[n] = 1.0f;
+    context->step_reals[n]   = (float)cos(omega);
+    context->step_imags[n]   = (float)sin(omega);
   }
 
-  free(shifted_reals);
-  free(shifted_imags);
-  free(window);
+  context->reals         = dsp::arena_alloc_floats(arena, buffer_size);
+  context->imags         = dsp::arena_alloc_floats(arena, buffer_size);
+  context->magnitudes    = dsp::arena_alloc_floats(arena, buffer_size);
+  context->peak_indexes  = (int *)dsp::arena_alloc(arena, buffer_size, sizeof(int));
+  context->shifted_reals = dsp::arena_alloc_floats(arena, buffer_size);
+  context->shifted_imags = dsp::arena_alloc_floats(arena, buffer_size);
+  context->region_starts = (int *)dsp::arena_alloc(arena, buffer_size, sizeof(int));
+  context->region_sizes  = (int *)dsp::arena_alloc(arena, buffer_size, sizeof(int));
+  context->region_shifts = (int *)dsp::arena_alloc(arena, buffer_size, sizeof(int));
+
+  return context;
+}
 
-  return outputs;
+// Planar input region (channel 0 (block size samples), channel 1 (block size samples), ...), its address does not change until `pitchshifter_destroy`
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *pitchshifter_inputs(const PITCHSHIFTER *context) {
+  return context->inputs;
 }
 
+// Planar output region (same layout as input region), its address does not change until `pitchshifter_destroy`
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *alloc_memory_inputs(const size_t buffer_size) {
-  if (inputs) {
-    free(inputs);
-  }
+float *pitchshifter_outputs(const PITCHSHIFTER *context) {
+  return context->outputs;
+}
+
+// Pushes `size` samples (block size or less) of every channel, and pulls `size` samples (delayed by FFT size).
+// Regions are planar by `size` (channel 0 (`size` samples), channel 1 (`size` samples), ...), so that the last block of a file may be short.
+// State continues across calls, so that offline rendering passes a whole buffer in blocks, and then FFT size samples of silence to flush.
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *pitchshifter_render(PITCHSHIFTER *context, const size_t size, const float pitch, const float speed) {
+  const size_t last_channel_number = context->number_of_channels - 1;
+
+  const size_t block_size = (size < context->block_size) ? size : context->block_size;
+
+  dsp::stft_process(context->stft, context->inputs, context->outputs, block_size, [&](const size_t channel_number, float *frame) {
+    pitchshifter_frame(context, frame, pitch, speed);
+
+    // Every channel of a hop shares phasors
+    if (channel_number == last_channel_number) {
+      pitchshifter_advance(context);
+    }
+  });
 
-  inputs = (float *)calloc(buffer_size, sizeof(float));
+  return context->outputs;
+}
 
-  return inputs;
+// Pushes block size samples of every channel, and pulls block size samples (delayed by FFT size)
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *pitchshifter(PITCHSHIFTER *context, const float pitch, const float speed) {
+  return pitchshifter_render(context, context->block_size, pitch, speed);
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,93 @@
+// Framing, windowing and overlap-add run in WebAssembly (`dsp::STFT`), so that this processor only pushes and pulls 128 samples
+class PhaseVocoderWasmProcessor extends AudioWorkletProcessor {
+  constructor(options) {
+    super(options);
+
+    this.instance = null;
+    this.pitch = 1;
+
+    this.fftSize = options.processorOptions.blockSize;
+    this.hopSize = options.processorOptions.hopSize ?? (this.fftSize / 4);
+
+    // Context (and its regions in linear memory) is created only when the number of channels changes
+    this.context = 0;
+    this.numberOfChannels = 0;
+
+    // Views of input and output regions (their offsets are fixed during the lifetime of context)
+    this.inputLinearMemory  = null;
+    this.outputLinearMemory = null;
+
+    this.port.onmessage = (event) => {
+      if (event.data.bytes instanceof ArrayBuffer) {
+        WebAssembly
+          .instantiate(event.data.bytes)
+          .then(async ({ instance }) => {
+            this.instance = instance;
+          })
+          .catch(console.error);
+      } else if (event.data.pitch > 0)  {
+        this.pitch = event.data.pitch;
+      }
+    };
+  }
+
+  bind(numberOfChannels) {
+    const { exports } = this.instance;
+
+    if (numberOfChannels !== this.numberOfChannels) {
+      exports.pitchshifter_destroy(this.context);
+
+      this.context = exports.pitchshifter_create(this.fftSize, this.hopSize, numberOfChannels, 128);
+      this.numberOfChannels = numberOfChannels;
+      this.inputLinearMemory = null;
+    }
+
+    // FFT size (or hop size) is not supported
+    if (this.context === 0) {
+      return;
+    }
+
+    // If linear memory grows, its previous `ArrayBuffer` is detached (and views become empty)
+    if ((this.inputLinearMemory === null) || (this.inputLinearMemory.length === 0)) {
+      const linearMemory = exports.memory.buffer;
+
+      this.inputLinearMemory  = new Float32Array(linearMemory, exports.pitchshifter_inputs(this.context), (numberOfChannels * 128));
+      this.outputLinearMemory = new Float32Array(linearMemory, exports.pitchshifter_outputs(this.context), (numberOfChannels * 128));
+    }
+  }
+
+  process(inputs, outputs) {
+    if (this.instance === null) {
+      return true;
+    }
+
+    const input  = inputs[0];
+    const output = outputs[0];
+
+    const numberOfChannels = input.length;
+
+    if (numberOfChannels === 0) {
+      return true;
+    }
+
+    this.bind(numberOfChannels);
+
+    if (this.context === 0) {
+      return true;
+    }
+
+    for (let channelNumber = 0; channelNumber < numberOfChannels; channelNumber++) {
+      this.inputLinearMemory.set(input[channelNumber], (channelNumber * 128));
+    }
+
+    this.instance.exports.pitchshifter(this.context, this.pitch, 1);
+
+    for (let channelNumber = 0; channelNumber < numberOfChannels; channelNumber++) {
+      output[channelNumber].set(this.outputLinearMemory.subarray((channelNumber * 128), ((channelNumber + 1) * 128)));
+    }
+
+    return true;
+  }
+}
+
+registerProcessor('PhaseVocoderWasmProcessor', PhaseVocoderWasmProcessor);
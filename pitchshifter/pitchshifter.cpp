@@ -1,228 +1,170 @@
 #include <stdlib.h>
 #include <math.h>
 
+#include "../dsp/FFT.hpp"
+#include "../dsp/arena.hpp"
+
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
+// Render quantum size (FFT is specialized on this size at compile time)
 static const int buffer_size = 128;
 
-static float *inputs  = nullptr;
-static float *outputs = nullptr;
-
-static inline int pow2(int n);
-static inline void swap(float *reals, float *imags, int i, int k);
+// Real input has N/2 + 1 independent bins (DC ~ Nyquist)
+static const int spectrum_size = (buffer_size / 2) + 1;
+
+// Quefrencies of spectral envelope (cepstrum over this order is fine structure).
+// Pitch periods are longer than a render quantum, so that spectrum of quantum is mostly envelope, and liftering only smooths ripple
+static const int cepstrum_order = 24;
+
+// Upper bound of envelope ratio (bins shifted from weak envelope are not amplified over 20 dB)
+static const float maximum_log_envelope_ratio = 2.302585f;
+
+// Log magnitude of silent bin is finite
+static const float minimum_power = 1e-20f;
+
+// Every buffer of an instance is allocated from its `arena` by `pitchshifter_create` (`pitchshifter` performs no heap operations).
+// One module instance serves any number of independent instances (e.g., tracks).
+typedef struct {
+  dsp::ARENA *arena;
+  size_t number_of_channels;
+  bool formant;
+  float *inputs;
+  float *outputs;
+} PITCHSHIFTER;
+
+// Scratch buffers (shared by every instance and channel, because they do not carry state between calls)
+static float input_reals[spectrum_size];
+static float input_imags[spectrum_size];
+static float output_reals[spectrum_size];
+static float output_imags[spectrum_size];
+static float log_envelopes[spectrum_size];
+
+// Log spectral envelope by cepstral liftering (`output` is used as cepstrum, because it is overwritten by shifted spectrum after this).
+//   log envelope = RFFT(lifter(IRFFT(log |X|)))
+static void pitchshifter_envelope(float *output) {
+  for (int k = 0; k < spectrum_size; k++) {
+    output_reals[k] = 0.5f * logf((input_reals[k] * input_reals[k]) + (input_imags[k] * input_imags[k]) + minimum_power);
+    output_imags[k] = 0.0f;
+  }
 
-static void FFT(float *reals, float *imags, int size);
-static void IFFT(float *reals, float *imags, int size);
+  dsp::IRFFT<buffer_size>(output_reals, output_imags, output);
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-#ifdef __EMSCRIPTEN__
-EMSCRIPTEN_KEEPALIVE
-#endif
-float *pitchshifter(const float pitch) {
-  if (outputs) {
-    free(outputs);
+  // Cepstrum of real spectrum is even (quefrency n and N - n are the same order)
+  for (int n = cepstrum_order + 1; n < (buffer_size - cepstrum_order); n++) {
+    output[n] = 0.0f;
   }
 
-  outputs = (float *)calloc(buffer_size, sizeof(float));
+  dsp::RFFT<buffer_size>(output, log_envelopes, output_imags);
+}
 
-  float *input_reals  = (float *)calloc(buffer_size, sizeof(float));
-  float *input_imags  = (float *)calloc(buffer_size, sizeof(float));
-  float *output_reals = (float *)calloc(buffer_size, sizeof(float));
-  float *output_imags = (float *)calloc(buffer_size, sizeof(float));
+static void pitchshifter_channel(const float *input, float *output, const float pitch, const bool formant) {
+  dsp::RFFT<buffer_size>(input, input_reals, input_imags);
 
-  for (int n = 0; n < buffer_size; n++) {
-    input_reals[n] = inputs[n];
-    input_imags[n] = 0.0f;
+  if (formant) {
+    pitchshifter_envelope(output);
   }
 
-  FFT(input_reals, input_imags, buffer_size);
-
-  int half_buffer_size = buffer_size / 2;
+  for (int k = 0; k < spectrum_size; k++) {
+    output_reals[k] = 0.0f;
+    output_imags[k] = 0.0f;
+  }
 
-  for (int k = 0; k < buffer_size; k++) {
+  // Bins over Nyquist are not representable by real signal (they are folded by aliasing).
+  // If formant is preserved, shifted bin is multiplied by envelope ratio (envelope of shifted bin / envelope of bin),
+  // so that fine structure (pitch) moves, but envelope (formant) stays in the same pass
+  for (int k = 0; k < spectrum_size; k++) {
     int offset = (int)floorf(pitch * k);
 
-    int eq = 1;
+    if ((offset >= 0) && (offset < spectrum_size)) {
+      const float gain = formant ? expf(fminf((log_envelopes[offset] - log_envelopes[k]), maximum_log_envelope_ratio)) : 1.0f;
 
-    if (k > half_buffer_size) {
-      eq = 0;
+      output_reals[offset] += input_reals[k] * gain;
+      output_imags[offset] += input_imags[k] * gain;
     }
-
-    if ((offset >= 0) && (offset < buffer_size)) {
-      output_reals[offset] += 2.0f * eq * input_reals[k];
-      output_imags[offset] += 2.0f * eq * input_imags[k];
-    }
-  }
-
-  IFFT(output_reals, output_imags, buffer_size);
-
-  for (int n = 0; n < buffer_size; n++) {
-    outputs[n] = output_reals[n];
   }
 
-  free(input_reals);
-  free(input_imags);
-  free(output_reals);
-  free(output_imags);
-
-  return outputs;
+  dsp::IRFFT<buffer_size>(output_reals, output_imags, output);
 }
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns `nullptr` if memory cannot be allocated
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *alloc_memory_inputs(void) {
-  if (inputs) {
-    free(inputs);
-  }
-
-  inputs = (float *)calloc(buffer_size, sizeof(float));
-
-  return inputs;
-}
+PITCHSHIFTER *pitchshifter_create(const size_t number_of_channels) {
+  const size_t capacity = dsp::arena_size(1, sizeof(PITCHSHIFTER))
+                        + (2 * dsp::arena_size(number_of_channels * buffer_size, sizeof(float)));
 
-#ifdef __cplusplus
-}
-#endif
+  dsp::ARENA *arena = dsp::create_arena(capacity);
 
-static inline int pow2(int n) {
-  if (n == 0) {
-    return 1;
+  if (arena == nullptr) {
+    return nullptr;
   }
 
-  return 2 << (n - 1);
-}
-
-static inline void swap(float *reals, float *imags, int i, int k) {
-  float tmp_real;
-  float tmp_imag;
+  PITCHSHIFTER *context = (PITCHSHIFTER *)dsp::arena_alloc(arena, 1, sizeof(PITCHSHIFTER));
 
-  tmp_real = reals[i];
-  tmp_imag = imags[i];
+  context->arena              = arena;
+  context->number_of_channels = number_of_channels;
+  context->formant            = false;
+  context->inputs             = dsp::arena_alloc_floats(arena, number_of_channels * buffer_size);
+  context->outputs            = dsp::arena_alloc_floats(arena, number_of_channels * buffer_size);
 
-  reals[i] = reals[k];
-  imags[i] = imags[k];
-
-  reals[k] = tmp_real;
-  imags[k] = tmp_imag;
+  return context;
 }
 
-static void FFT(float *reals, float *imags, int size) {
-  int number_of_stages = (int)log2f((float)size);
-
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      int rest = number_of_stages - stage;
-
-      for (int j = 0; j < pow2(rest); j++) {
-        int n = i * pow2(rest + 1) + j;
-        int m = pow2(rest) + n;
-        int r = j * pow2(stage - 1);
-
-        float a_real = reals[n];
-        float a_imag = imags[n];
-        float b_real = reals[m];
-        float b_imag = imags[m];
-        float c_real = cosf((2.0f * M_PI * r) / size);
-        float c_imag = 0 - sinf((2.0f * M_PI * r) / size);
-
-        if (stage < number_of_stages) {
-          reals[n] = a_real + b_real;
-          imags[n] = a_imag + b_imag;
-          reals[m] = (c_real * (a_real - b_real)) - (c_imag * (a_imag - b_imag));
-          imags[m] = (c_real * (a_imag - b_imag)) + (c_imag * (a_real - b_real));
-        } else {
-          reals[n] = a_real + b_real;
-          imags[n] = a_imag + b_imag;
-          reals[m] = a_real - b_real;
-          imags[m] = a_imag - b_imag;
-        }
-      }
-    }
-  }
-
-  int *index = (int *)calloc(size, sizeof(int));
-
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    int rest = number_of_stages - stage;
-
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      index[pow2(stage - 1) + i] = index[i] + pow2(rest);
-    }
-  }
-
-  for (int k = 0; k < size; k++) {
-    if (index[k] <= k) {
-      continue;
-    }
-
-    swap(reals, imags, index[k], k);
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+void pitchshifter_destroy(PITCHSHIFTER *context) {
+  if (context == nullptr) {
+    return;
   }
 
-  free(index);
+  // Instance itself is in the arena
+  dsp::destroy_arena(context->arena);
 }
 
-static void IFFT(float *reals, float *imags, int size) {
-  int number_of_stages = (int)log2f((float)size);
-
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      int rest = number_of_stages - stage;
-
-      for (int j = 0; j < pow2(rest); j++) {
-        int n = i * pow2(rest + 1) + j;
-        int m = pow2(rest) + n;
-        int r = j * pow2(stage - 1);
-
-        float a_real = reals[n];
-        float a_imag = imags[n];
-        float b_real = reals[m];
-        float b_imag = imags[m];
-        float c_real = cosf((2.0f * M_PI * r) / size);
-        float c_imag = sinf((2.0f * M_PI * r) / size);
-
-        if (stage < number_of_stages) {
-          reals[n] = a_real + b_real;
-          imags[n] = a_imag + b_imag;
-          reals[m] = (c_real * (a_real - b_real)) - (c_imag * (a_imag - b_imag));
-          imags[m] = (c_real * (a_imag - b_imag)) + (c_imag * (a_real - b_real));
-        } else {
-          reals[n] = a_real + b_real;
-          imags[n] = a_imag + b_imag;
-          reals[m] = a_real - b_real;
-          imags[m] = a_imag - b_imag;
-        }
-      }
-    }
-  }
-
-  int *index = (int *)calloc(size, sizeof(int));
-
-  for (int stage = 1; stage <= number_of_stages; stage++) {
-    int rest = number_of_stages - stage;
+// If `formant` is true, spectral envelope (formant) is preserved (e.g., voice does not sound like chipmunk)
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+void pitchshifter_configure(PITCHSHIFTER *context, const bool formant) {
+  context->formant = formant;
+}
 
-    for (int i = 0; i < pow2(stage - 1); i++) {
-      index[pow2(stage - 1) + i] = index[i] + pow2(rest);
-    }
-  }
+// Planar input region (channel 0 (128 samples), channel 1 (128 samples), ...), its address does not change until `pitchshifter_destroy`
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *pitchshifter_inputs(const PITCHSHIFTER *context) {
+  return context->inputs;
+}
 
-  for (int k = 0; k < size; k++) {
-    if (index[k] <= k) {
-      continue;
-    }
+// Planar output region (same layout as input region), its address does not change until `pitchshifter_destroy`
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *pitchshifter_outputs(const PITCHSHIFTER *context) {
+  return context->outputs;
+}
 
-    swap(reals, imags, index[k], k);
+// Returns planar output region (same layout as input region)
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *pitchshifter(PITCHSHIFTER *context, const float pitch) {
+  for (size_t c = 0; c < context->number_of_channels; c++) {
+    pitchshifter_channel((context->inputs + (c * buffer_size)), (context->outputs + (c * buffer_size)), pitch, context->formant);
   }
 
-  for (int k = 0; k < size; k++) {
-    reals[k] /= size;
-    imags[k] /= size;
-  }
+  return context->outputs;
+}
 
-  free(index);
+#ifdef __cplusplus
 }
+#endif
@@ -4,6 +4,15 @@ class PitchShifterProcessor extends AudioWorkletProcessor {
 
     this.instance = null;
     this.pitch = 1;
+    this.formant = false;
+
+    // Context (and its regions in linear memory) is created only when the number of channels changes
+    this.context = 0;
+    this.numberOfChannels = 0;
+
+    // Views of input and output regions (their offsets are fixed during the lifetime of context)
+    this.inputLinearMemory  = null;
+    this.outputLinearMemory = null;
 
     this.port.onmessage = (event) => {
       if (event.data.bytes instanceof ArrayBuffer) {
@@ -15,10 +24,47 @@ class PitchShifterProcessor extends AudioWorkletProcessor {
           .catch(console.error);
       } else if (event.data.pitch > 0)  {
         this.pitch = event.data.pitch;
+      } else if (typeof event.data.formant === 'boolean') {
+        this.formant = event.data.formant;
+
+        if (this.context !== 0) {
+          this.instance.exports.pitchshifter_configure(this.context, this.formant);
+        }
       }
     };
   }
 
+  bind(numberOfChannels) {
+    const { exports } = this.instance;
+
+    if (numberOfChannels !== this.numberOfChannels) {
+      exports.pitchshifter_destroy(this.context);
+
+      this.context = exports.pitchshifter_create(numberOfChannels);
+      this.numberOfChannels = numberOfChannels;
+      this.inputLinearMemory = null;
+
+      // Memory cannot be allocated
+      if (this.context === 0) {
+        return;
+      }
+
+      exports.pitchshifter_configure(this.context, this.formant);
+    }
+
+    if (this.context === 0) {
+      return;
+    }
+
+    // If linear memory grows, its previous `ArrayBuffer` is detached (and views become empty)
+    if ((this.inputLinearMemory === null) || (this.inputLinearMemory.length === 0)) {
+      const linearMemory = exports.memory.buffer;
+
+      this.inputLinearMemory  = new Float32Array(linearMemory, exports.pitchshifter_inputs(this.context), (numberOfChannels * 128));
+      this.outputLinearMemory = new Float32Array(linearMemory, exports.pitchshifter_outputs(this.context), (numberOfChannels * 128));
+    }
+  }
+
   process(inputs, outputs) {
     if (this.instance === null) {
       return false;
@@ -29,23 +75,27 @@ class PitchShifterProcessor extends AudioWorkletProcessor {
     const input  = inputs[0];
     const output = outputs[0];
 
-    const linearMemory = this.instance.exports.memory.buffer;
+    const numberOfChannels = input.length;
+
+    if (this.pitch !== 1) {
+      this.bind(numberOfChannels);
+    }
 
-    for (let channelNumber = 0; channelNumber < input.length; channelNumber++) {
-      if (this.pitch === 1) {
+    // Pitch is not changed (or context cannot be created)
+    if ((this.pitch === 1) || (this.context === 0)) {
+      for (let channelNumber = 0; channelNumber < numberOfChannels; channelNumber++) {
         output[channelNumber].set(input[channelNumber]);
-        continue;
+      }
+    } else {
+      for (let channelNumber = 0; channelNumber < numberOfChannels; channelNumber++) {
+        this.inputLinearMemory.set(input[channelNumber], (channelNumber * 128));
       }
 
-      const inputOffset = this.instance.exports.alloc_memory_inputs();
-
-      const inputLinearMemory = new Float32Array(linearMemory, inputOffset, 128);
-
-      inputLinearMemory.set(input[channelNumber]);
-
-      const outputOffset = this.instance.exports.pitchshifter(this.pitch);
+      this.instance.exports.pitchshifter(this.context, this.pitch);
 
-      output[channelNumber].set(new Float32Array(linearMemory, outputOffset, 128));
+      for (let channelNumber = 0; channelNumber < numberOfChannels; channelNumber++) {
+        output[channelNumber].set(this.outputLinearMemory.subarray((channelNumber * 128), ((channelNumber + 1) * 128)));
+      }
     }
 
     console.timeEnd(`currentFrame ${currentFrame}`);
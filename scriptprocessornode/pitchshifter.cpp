@@ -29,7 +29,7 @@ float *pitchshifter(const float pitch, const float speed) {
 
   float *window = (float *)calloc(buffer_size, sizeof(float));
 
-  window_function(window, buffer_size, RECTANGULAR);
+  apply_window_function(window, buffer_size, RECTANGULAR);
 
   for (int n = 0; n < buffer_size; n++) {
     input_reals[n] = window[n] * inputs[n];
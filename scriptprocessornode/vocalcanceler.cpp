@@ -1,5 +1,6 @@
 #include "constants.hpp"
 #include "FFT.hpp"
+#include "../dsp/spectral_mask.hpp"
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
@@ -18,14 +19,6 @@ static float *outputs  = nullptr;
 extern "C" {
 #endif
 
-static inline float complex_abs(const float real, const float imag) {
-  return sqrtf(powf(real, 2.0f) + powf(imag, 2.0f));
-}
-
-static inline float complex_arg(const float real, const float imag) {
-  return atan2f(imag, real);
-}
-
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 float *vocalcancelerL(const float depth) {
@@ -72,8 +65,8 @@ float *vocalcanceler_on_spectrum(const float sample_rate, const float min_freque
   float *imagLs = (float *)calloc(buffer_size, sizeof(float));
   float *imagRs = (float *)calloc(buffer_size, sizeof(float));
 
-  window_function(inputLs, buffer_size, RECTANGULAR);
-  window_function(inputRs, buffer_size, RECTANGULAR);
+  apply_window_function(inputLs, buffer_size, RECTANGULAR);
+  apply_window_function(inputRs, buffer_size, RECTANGULAR);
 
   for (int n = 0; n < buffer_size; n++) {
     realLs[n] = inputLs[n];
@@ -85,51 +78,49 @@ float *vocalcanceler_on_spectrum(const float sample_rate, const float min_freque
   FFT(realLs, imagLs, buffer_size);
   FFT(realRs, imagRs, buffer_size);
 
-  float *absLs = (float *)calloc(buffer_size, sizeof(float));
-  float *absRs = (float *)calloc(buffer_size, sizeof(float));
-  float *argLs = (float *)calloc(buffer_size, sizeof(float));
-  float *argRs = (float *)calloc(buffer_size, sizeof(float));
+  float *powerLs = (float *)calloc(buffer_size, sizeof(float));
+  float *powerRs = (float *)calloc(buffer_size, sizeof(float));
+  float *gainLs  = (float *)calloc(buffer_size, sizeof(float));
+  float *gainRs  = (float *)calloc(buffer_size, sizeof(float));
+
+  dsp::spectral_powers(realLs, imagLs, powerLs, buffer_size);
+  dsp::spectral_powers(realRs, imagRs, powerRs, buffer_size);
 
   for (int k = 0; k < buffer_size; k++) {
-    absLs[k] = complex_abs(realLs[k], imagLs[k]);
-    absRs[k] = complex_abs(realRs[k], imagRs[k]);
-    argLs[k] = complex_arg(realLs[k], imagLs[k]);
-    argRs[k] = complex_arg(realRs[k], imagRs[k]);
+    gainLs[k] = 1.0f;
+    gainRs[k] = 1.0f;
   }
 
   int min = (int)(min_frequency * (buffer_size / sample_rate));
   int max = (int)(max_frequency * (buffer_size / sample_rate));
 
+  // (|L| - |R|)^2 / (|L| + |R|)^2 < threshold, where (|L| +- |R|)^2 = |L|^2 + |R|^2 +- (2 * sqrt(|L|^2 * |R|^2))
+  // (so that magnitudes are not required, and division is replaced by multiplication)
   for (int k = min; k < max; k++) {
-    float numerator   = powf((absLs[k] - absRs[k]), 2.0f);
-    float denominator = powf((absLs[k] + absRs[k]), 2.0f);
-
-    if (denominator != 0.0f) {
-      float diff = numerator / denominator;
-
-      if (diff < threshold) {
-        absLs[k] = minimum_amplitude;
-        absRs[k] = minimum_amplitude;
-
-        absLs[buffer_size - k] = absLs[k];
-        absRs[buffer_size - k] = absRs[k];
+    float cross       = 2.0f * sqrtf(powerLs[k] * powerRs[k]);
+    float numerator   = (powerLs[k] + powerRs[k]) - cross;
+    float denominator = (powerLs[k] + powerRs[k]) + cross;
+
+    if ((denominator != 0.0f) && (numerator < (threshold * denominator))) {
+      // Magnitudes become `minimum_amplitude` (phases are kept by real gains)
+      gainLs[k] = minimum_amplitude / sqrtf(powerLs[k] + dsp::minimum_spectral_power);
+      gainRs[k] = minimum_amplitude / sqrtf(powerRs[k] + dsp::minimum_spectral_power);
+
+      // Negative frequencies (DC has no mirror)
+      if (k > 0) {
+        gainLs[buffer_size - k] = gainLs[k];
+        gainRs[buffer_size - k] = gainRs[k];
       }
     }
   }
 
-  // Euler's formula
-  // abs * exp(j * arg) = abs * (cos(arg) + j * sin(arg))
-  for (int k = 0; k < buffer_size; k++) {
-    realLs[k] = absLs[k] * cosf(argLs[k]);
-    realRs[k] = absRs[k] * cosf(argRs[k]);
-    imagLs[k] = absLs[k] * sinf(argLs[k]);
-    imagRs[k] = absRs[k] * sinf(argRs[k]);
-  }
+  dsp::apply_spectral_gains(realLs, imagLs, gainLs, buffer_size);
+  dsp::apply_spectral_gains(realRs, imagRs, gainRs, buffer_size);
 
-  free(absLs);
-  free(absRs);
-  free(argLs);
-  free(argRs);
+  free(powerLs);
+  free(powerRs);
+  free(gainLs);
+  free(gainRs);
 
   IFFT(realLs, imagLs, buffer_size);
   IFFT(realRs, imagRs, buffer_size);
@@ -4,21 +4,62 @@ class VocalCancelerProcessor extends AudioWorkletProcessor {
 
     this.instance = null;
     this.depth = 0;
+    this.context = 0;
+
+    // Band of mid that depth applies to (0 is no edge)
+    this.minFrequency = 0;
+    this.maxFrequency = 0;
+
+    // Views of input and output regions (L, then R), their offsets are fixed during the lifetime of context
+    this.inputLinearMemory  = null;
+    this.outputLinearMemory = null;
 
     this.port.onmessage = (event) => {
       if (event.data.bytes instanceof ArrayBuffer) {
         WebAssembly
           .instantiate(event.data.bytes)
           .then(async ({ instance }) => {
+            // Context (input and output regions) is created once
+            this.context = instance.exports.vocalcanceler_create();
             this.instance = instance;
+
+            // Memory cannot be allocated
+            if (this.context === 0) {
+              return;
+            }
+
+            this.configure();
           })
           .catch(console.error);
       } else if ((event.data.depth >= 0) && (event.data.depth <= 1))  {
         this.depth = event.data.depth;
+      } else if ((typeof event.data.minFrequency === 'number') && (typeof event.data.maxFrequency === 'number')) {
+        this.minFrequency = event.data.minFrequency;
+        this.maxFrequency = event.data.maxFrequency;
+
+        if ((this.instance !== null) && (this.context !== 0)) {
+          this.configure();
+        }
       }
     };
   }
 
+  configure() {
+    this.instance.exports.vocalcanceler_configure(this.context, sampleRate, this.minFrequency, this.maxFrequency);
+  }
+
+  bind() {
+    // If linear memory grows, its previous `ArrayBuffer` is detached (and views become empty)
+    if ((this.inputLinearMemory === null) || (this.inputLinearMemory.length === 0)) {
+      const { exports } = this.instance;
+
+      const linearMemory = exports.memory.buffer;
+
+      this.inputLinearMemory  = new Float32Array(linearMemory, exports.vocalcanceler_inputs(this.context), (2 * 128));
+      this.outputLinearMemory = new Float32Array(linearMemory, exports.vocalcanceler_outputs(this.context), (2 * 128));
+    }
+  }
+
   process(inputs, outputs) {
     if (this.instance === null) {
       return false;
@@ -29,7 +70,8 @@ class VocalCancelerProcessor extends AudioWorkletProcessor {
     const input  = inputs[0];
     const output = outputs[0];
 
-    if ((input.length !== 2) || (output.length !== 2)) {
+    // Input passes through if it is not stereo (or context cannot be created)
+    if ((input.length !== 2) || (output.length !== 2) || (this.context === 0)) {
       output[0].set(input[0]);
 
       return true;
@@ -40,22 +82,16 @@ class VocalCancelerProcessor extends AudioWorkletProcessor {
     const outputLs = output[0];
     const outputRs = output[1];
 
-    const linearMemory = this.instance.exports.memory.buffer;
-
-    const inputOffsetL = this.instance.exports.alloc_memory_inputLs();
-    const inputOffsetR = this.instance.exports.alloc_memory_inputRs();
-
-    const inputLinearMemoryLs = new Float32Array(linearMemory, inputOffsetL, 128);
-    const inputLinearMemoryRs = new Float32Array(linearMemory, inputOffsetR, 128);
+    this.bind();
 
-    inputLinearMemoryLs.set(inputLs);
-    inputLinearMemoryRs.set(inputRs);
+    this.inputLinearMemory.set(inputLs, 0);
+    this.inputLinearMemory.set(inputRs, 128);
 
-    const outputOffsetL = this.instance.exports.vocalcancelerL(this.depth);
-    const outputOffsetR = this.instance.exports.vocalcancelerR(this.depth);
+    // L and R are computed in one pass
+    this.instance.exports.vocalcanceler(this.context, this.depth);
 
-    outputLs.set(new Float32Array(linearMemory, outputOffsetL, 128));
-    outputRs.set(new Float32Array(linearMemory, outputOffsetR, 128));
+    outputLs.set(this.outputLinearMemory.subarray(0, 128));
+    outputRs.set(this.outputLinearMemory.subarray(128, 256));
 
     console.timeEnd(`currentFrame ${currentFrame}`);
 
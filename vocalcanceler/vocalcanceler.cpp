@@ -1,4 +1,8 @@
 #include <stdlib.h>
+#include <math.h>
+
+#include "../dsp/SIMD.hpp"
+#include "../dsp/arena.hpp"
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
@@ -6,74 +10,252 @@
 
 static const int buffer_size = 128;
 
-static float *inputLs  = nullptr;
-static float *inputRs  = nullptr;
-static float *outputLs = nullptr;
-static float *outputRs = nullptr;
+// Samples per vector (and per block of band-limited path)
+static const int lanes = 4;
+
+// Second order section (transposed direct form II, `a0` is normalized to 1)
+typedef struct {
+  float b0;
+  float b1;
+  float b2;
+  float a1;
+  float a2;
+  float z1;
+  float z2;
+} BIQUAD;
+
+// Every buffer of an instance is allocated from its `arena` by `vocalcanceler_create` (`vocalcanceler` performs no heap operations).
+// One module instance serves any number of independent instances (e.g., tracks).
+// Both channels are computed in one pass (L and R are read once, and L - depth x R and R - depth x L are written together).
+// In mid/side, that is mid x (1 - depth) + side x (1 + depth), so that depth can be limited to a band of mid
+// (mid - depth x band(mid), `band` is high-pass at `min_frequency` then low-pass at `max_frequency`, e.g., vocal range).
+typedef struct {
+  dsp::ARENA *arena;
+  bool highpass;
+  bool lowpass;
+  BIQUAD highpass_filter;
+  BIQUAD lowpass_filter;
+  float *inputLs;
+  float *inputRs;
+  float *outputLs;
+  float *outputRs;
+} VOCALCANCELER;
+
+// Butterworth (Q = 1 / sqrt(2)) high-pass or low-pass by bilinear transform, state is cleared
+static void vocalcanceler_biquad(BIQUAD *biquad, const float sample_rate, const float frequency, const bool highpass) {
+  const float omega = (2.0f * M_PI * frequency) / sample_rate;
+  const float alpha = sinf(omega) / (2.0f * (float)M_SQRT1_2);
+  const float cosw  = cosf(omega);
+  const float a0    = 1.0f + alpha;
+
+  const float b1 = highpass ? -(1.0f + cosw) : (1.0f - cosw);
+  const float b0 = highpass ? (-0.5f * b1) : (0.5f * b1);
+
+  biquad->b0 = b0 / a0;
+  biquad->b1 = b1 / a0;
+  biquad->b2 = b0 / a0;
+  biquad->a1 = (-2.0f * cosw) / a0;
+  biquad->a2 = (1.0f - alpha) / a0;
+  biquad->z1 = 0.0f;
+  biquad->z2 = 0.0f;
+}
+
+static inline float vocalcanceler_filter(BIQUAD *biquad, const float x) {
+  const float y = (biquad->b0 * x) + biquad->z1;
+
+  biquad->z1 = ((biquad->b1 * x) - (biquad->a1 * y)) + biquad->z2;
+  biquad->z2 = (biquad->b2 * x) - (biquad->a2 * y);
+
+  return y;
+}
+
+// L - depth x R and R - depth x L
+static void vocalcanceler_full_band(VOCALCANCELER *context, const float depth) {
+  const float *inputLs = context->inputLs;
+  const float *inputRs = context->inputRs;
+
+  float *outputLs = context->outputLs;
+  float *outputRs = context->outputRs;
+
+#ifdef DSP_SIMD
+  typedef dsp::F32X4 V;
+
+  const V::type depths = V::splat(depth);
+
+  for (int n = 0; n < buffer_size; n += lanes) {
+    const V::type l = V::load(&inputLs[n]);
+    const V::type r = V::load(&inputRs[n]);
+
+    V::store(&outputLs[n], V::sub(l, V::mul(depths, r)));
+    V::store(&outputRs[n], V::sub(r, V::mul(depths, l)));
+  }
+#else
+  for (int n = 0; n < buffer_size; n++) {
+    const float l = inputLs[n];
+    const float r = inputRs[n];
+
+    outputLs[n] = l - (depth * r);
+    outputRs[n] = r - (depth * l);
+  }
+#endif
+}
+
+// mid - depth x band(mid) +- side x (1 + depth).
+// Filters are recursive (serial per sample), so that `lanes` samples of mid are filtered by scalar between vector operations of the same pass
+static void vocalcanceler_band(VOCALCANCELER *context, const float depth) {
+  const float *inputLs = context->inputLs;
+  const float *inputRs = context->inputRs;
+
+  float *outputLs = context->outputLs;
+  float *outputRs = context->outputRs;
+
+  const bool highpass = context->highpass;
+  const bool lowpass  = context->lowpass;
+
+  BIQUAD *highpass_filter = &context->highpass_filter;
+  BIQUAD *lowpass_filter  = &context->lowpass_filter;
+
+  float mids[lanes];
+
+#ifdef DSP_SIMD
+  typedef dsp::F32X4 V;
+
+  const V::type halves      = V::splat(0.5f);
+  const V::type depths      = V::splat(depth);
+  const V::type side_depths = V::splat(1.0f + depth);
+
+  for (int n = 0; n < buffer_size; n += lanes) {
+    const V::type l = V::load(&inputLs[n]);
+    const V::type r = V::load(&inputRs[n]);
+
+    const V::type mid  = V::mul(halves, V::add(l, r));
+    const V::type side = V::mul(side_depths, V::mul(halves, V::sub(l, r)));
+
+    V::store(mids, mid);
+
+    for (int lane = 0; lane < lanes; lane++) {
+      const float x = highpass ? vocalcanceler_filter(highpass_filter, mids[lane]) : mids[lane];
+
+      mids[lane] = lowpass ? vocalcanceler_filter(lowpass_filter, x) : x;
+    }
+
+    const V::type canceled = V::sub(mid, V::mul(depths, V::load(mids)));
+
+    V::store(&outputLs[n], V::add(canceled, side));
+    V::store(&outputRs[n], V::sub(canceled, side));
+  }
+#else
+  for (int n = 0; n < buffer_size; n += lanes) {
+    float sides[lanes];
+
+    for (int lane = 0; lane < lanes; lane++) {
+      const float l = inputLs[n + lane];
+      const float r = inputRs[n + lane];
+
+      mids[lane]  = 0.5f * (l + r);
+      sides[lane] = (1.0f + depth) * (0.5f * (l - r));
+    }
+
+    for (int lane = 0; lane < lanes; lane++) {
+      const float mid = mids[lane];
+      const float x   = highpass ? vocalcanceler_filter(highpass_filter, mid) : mid;
+
+      const float canceled = mid - (depth * (lowpass ? vocalcanceler_filter(lowpass_filter, x) : x));
+
+      outputLs[n + lane] = canceled + sides[lane];
+      outputRs[n + lane] = canceled - sides[lane];
+    }
+  }
+#endif
+}
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Returns `nullptr` if memory cannot be allocated
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *vocalcancelerL(const float depth) {
-  if (outputLs) {
-    free(outputLs);
+VOCALCANCELER *vocalcanceler_create(void) {
+  dsp::ARENA *arena = dsp::create_arena(dsp::arena_size(1, sizeof(VOCALCANCELER)) + (4 * dsp::arena_size(buffer_size, sizeof(float))));
+
+  if (arena == nullptr) {
+    return nullptr;
   }
 
-  outputLs = (float *)calloc(buffer_size, sizeof(float));
+  VOCALCANCELER *context = (VOCALCANCELER *)dsp::arena_alloc(arena, 1, sizeof(VOCALCANCELER));
 
-  for (int n = 0; n < buffer_size; n++) {
-    outputLs[n] = inputLs[n] - (depth * inputRs[n]);
-  }
+  // `inputRs` follows `inputLs`, and `outputRs` follows `outputLs` without gap (128 floats are multiple of alignment)
+  context->arena    = arena;
+  context->inputLs  = dsp::arena_alloc_floats(arena, buffer_size);
+  context->inputRs  = dsp::arena_alloc_floats(arena, buffer_size);
+  context->outputLs = dsp::arena_alloc_floats(arena, buffer_size);
+  context->outputRs = dsp::arena_alloc_floats(arena, buffer_size);
 
-  return outputLs;
+  return context;
 }
 
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *vocalcancelerR(const float depth) {
-  if (outputRs) {
-    free(outputRs);
+void vocalcanceler_destroy(VOCALCANCELER *context) {
+  if (context == nullptr) {
+    return;
   }
 
-  outputRs = (float *)calloc(buffer_size, sizeof(float));
+  // Instance itself is in the arena
+  dsp::destroy_arena(context->arena);
+}
 
-  for (int n = 0; n < buffer_size; n++) {
-    outputRs[n] = inputRs[n] - (depth * inputLs[n]);
-  }
+// Input region (L channel (128 samples), then R channel (128 samples)), its address does not change until `vocalcanceler_destroy`
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *vocalcanceler_inputs(const VOCALCANCELER *context) {
+  return context->inputLs;
+}
 
-  return outputRs;
+// Output region (L channel (128 samples), then R channel (128 samples)), its address does not change until `vocalcanceler_destroy`
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+float *vocalcanceler_outputs(const VOCALCANCELER *context) {
+  return context->outputLs;
 }
 
+// Band of mid that depth applies to. If `min_frequency` is 0 (or less), band has no lower edge,
+// and if `max_frequency` is 0 (or less) or Nyquist (or more), band has no upper edge (both are none by default, it is the same as L - depth x R).
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *alloc_memory_inputLs(void) {
-  if (inputLs) {
-    free(inputLs);
-  }
+void vocalcanceler_configure(VOCALCANCELER *context, const float sample_rate, const float min_frequency, const float max_frequency) {
+  context->highpass = (min_frequency > 0.0f) && (min_frequency < (0.5f * sample_rate));
+  context->lowpass  = (max_frequency > 0.0f) && (max_frequency < (0.5f * sample_rate));
 
-  inputLs = (float *)calloc(buffer_size, sizeof(float));
+  if (context->highpass) {
+    vocalcanceler_biquad(&context->highpass_filter, sample_rate, min_frequency, true);
+  }
 
-  return inputLs;
+  if (context->lowpass) {
+    vocalcanceler_biquad(&context->lowpass_filter, sample_rate, max_frequency, false);
+  }
 }
 
+// Returns output region (L channel (128 samples), then R channel (128 samples))
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
 #endif
-float *alloc_memory_inputRs(void) {
-  if (inputRs) {
-    free(inputRs);
+float *vocalcanceler(VOCALCANCELER *context, const float depth) {
+  if (context->highpass || context->lowpass) {
+    vocalcanceler_band(context, depth);
+  } else {
+    vocalcanceler_full_band(context, depth);
   }
 
-  inputRs = (float *)calloc(buffer_size, sizeof(float));
-
-  return inputRs;
+  return context->outputLs;
 }
+
 #ifdef __cplusplus
 }
 #endif